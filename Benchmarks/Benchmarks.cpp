@@ -0,0 +1,155 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../TopStocks.hpp"
+#include "Workloads.hpp"
+
+namespace top_stocks
+{
+
+namespace benchmarks
+{
+
+struct NullHandler final : ITopStocksHandler
+{
+    void ProcessTopGainersChanged(const TTopList& aTop) override
+    {
+        mSink += aTop[0].first;
+    }
+
+    void ProcessTopLosersChanged(const TTopList& aTop) override
+    {
+        mSink += aTop[0].first;
+    }
+
+    // Keeps the callbacks from being optimized away.
+    TId mSink = 0;
+};
+
+struct Result
+{
+    double TicksPerSecond;
+    double NotificationsPerSecond;
+    std::uint64_t Restores;
+    std::chrono::nanoseconds P50;
+    std::chrono::nanoseconds P99;
+    std::chrono::nanoseconds P999;
+};
+
+using TBenchmarkClock = std::chrono::steady_clock;
+
+// The throughput is measured by an untimed pass, the latencies by a second pass reading the clock per tick.
+// The opening ticks of the workload warm the engine up and are not measured.
+template <typename TTopStocks>
+Result Run(const std::vector<Quote>& aQuotes, size_t aSymbols)
+{
+    Result result {};
+
+    {
+        NullHandler handler;
+        TTopStocks topStocks(handler);
+        for (size_t i = 0; i < aSymbols; ++i)
+        {
+            topStocks.OnQuote(aQuotes[i].StockId, aQuotes[i].Price);
+        }
+        auto opening = topStocks.Metrics();
+
+        auto start = TBenchmarkClock::now();
+        for (size_t i = aSymbols; i < aQuotes.size(); ++i)
+        {
+            topStocks.OnQuote(aQuotes[i].StockId, aQuotes[i].Price);
+        }
+        std::chrono::duration<double> elapsed = TBenchmarkClock::now() - start;
+
+        auto metrics = topStocks.Metrics();
+        auto notifications = metrics.Gainers.Notifications + metrics.Losers.Notifications
+            - opening.Gainers.Notifications - opening.Losers.Notifications;
+        result.TicksPerSecond = (aQuotes.size() - aSymbols) / elapsed.count();
+        result.NotificationsPerSecond = notifications / elapsed.count();
+        result.Restores = metrics.Gainers.Restores + metrics.Losers.Restores
+            - opening.Gainers.Restores - opening.Losers.Restores;
+    }
+
+    {
+        NullHandler handler;
+        TTopStocks topStocks(handler);
+        for (size_t i = 0; i < aSymbols; ++i)
+        {
+            topStocks.OnQuote(aQuotes[i].StockId, aQuotes[i].Price);
+        }
+
+        std::vector<std::chrono::nanoseconds> latencies;
+        latencies.reserve(aQuotes.size() - aSymbols);
+        for (size_t i = aSymbols; i < aQuotes.size(); ++i)
+        {
+            auto start = TBenchmarkClock::now();
+            topStocks.OnQuote(aQuotes[i].StockId, aQuotes[i].Price);
+            latencies.push_back(TBenchmarkClock::now() - start);
+        }
+
+        auto percentile = [&latencies](double aFraction)
+        {
+            auto nth = latencies.begin() + static_cast<size_t>(aFraction * (latencies.size() - 1));
+            std::nth_element(latencies.begin(), nth, latencies.end());
+            return *nth;
+        };
+        result.P50 = percentile(0.5);
+        result.P99 = percentile(0.99);
+        result.P999 = percentile(0.999);
+    }
+
+    return result;
+}
+
+}
+}
+
+// Usage: Benchmarks [ticks per run] [scenario]
+// Prints one JSON object per scenario, symbol count, change model and handler dispatch.
+int main(int argc, char *argv[])
+{
+    using namespace top_stocks;
+    using namespace top_stocks::benchmarks;
+
+    size_t ticks = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    std::string filter = argc > 2 ? argv[2] : "";
+
+    for (const auto& scenario : Scenarios())
+    {
+        if (!filter.empty() && filter != scenario.Name)
+        {
+            continue;
+        }
+
+        for (size_t symbols : {1000, 10000, 100000})
+        {
+            auto quotes = scenario.Workload(symbols, ticks, 42);
+            auto print = [&](const char* aChanges, const char* aDispatch, const Result& aResult)
+            {
+                std::cout << "{\"scenario\": \"" << scenario.Name << "\""
+                    << ", \"symbols\": " << symbols
+                    << ", \"changes\": \"" << aChanges << "\""
+                    << ", \"dispatch\": \"" << aDispatch << "\""
+                    << ", \"ticks\": " << ticks
+                    << ", \"ticks_per_sec\": " << static_cast<std::uint64_t>(aResult.TicksPerSecond)
+                    << ", \"notifications_per_sec\": " << static_cast<std::uint64_t>(aResult.NotificationsPerSecond)
+                    << ", \"restores\": " << aResult.Restores
+                    << ", \"p50_ns\": " << aResult.P50.count()
+                    << ", \"p99_ns\": " << aResult.P99.count()
+                    << ", \"p999_ns\": " << aResult.P999.count()
+                    << "}" << std::endl;
+            };
+
+            print("percent", "virtual", Run<TopStocks>(quotes, symbols));
+            print("basis-points", "virtual", Run<BasicTopStocks<TopSize, TopMaxCapacity, BasisPointChange<>>>(quotes, symbols));
+            print("percent", "static", Run<StaticTopStocks<NullHandler>>(quotes, symbols));
+        }
+    }
+
+    return 0;
+}
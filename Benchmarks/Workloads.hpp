@@ -0,0 +1,180 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../ITopStocks.hpp"
+
+namespace top_stocks
+{
+
+namespace benchmarks
+{
+
+// Generates a reproducible tick sequence over the given number of symbols. Every workload opens all the
+// symbols at their base price first, the opening ticks are part of the sequence.
+using TWorkload = std::function<std::vector<Quote>(size_t aSymbols, size_t aTicks, unsigned aSeed)>;
+
+struct Scenario
+{
+    std::string Name;
+    TWorkload Workload;
+};
+
+namespace details
+{
+
+inline double BasePrice(TId aStockId)
+{
+    return 10 + aStockId % 990;
+}
+
+inline std::vector<Quote> Open(size_t aSymbols, size_t aTicks)
+{
+    std::vector<Quote> quotes;
+    quotes.reserve(aSymbols + aTicks);
+    for (size_t i = 1; i <= aSymbols; ++i)
+    {
+        quotes.push_back({static_cast<TId>(i), BasePrice(static_cast<TId>(i))});
+    }
+    return quotes;
+}
+
+}
+
+// Random symbols, prices within 10% of the base.
+inline std::vector<Quote> Uniform(size_t aSymbols, size_t aTicks, unsigned aSeed)
+{
+    std::mt19937 random(aSeed);
+    std::uniform_int_distribution<TId> ids(1, static_cast<TId>(aSymbols));
+    std::uniform_real_distribution<double> moves(0.9, 1.1);
+
+    auto quotes = details::Open(aSymbols, aTicks);
+    for (size_t i = 0; i < aTicks; ++i)
+    {
+        TId id = ids(random);
+        quotes.push_back({id, details::BasePrice(id) * moves(random)});
+    }
+    return quotes;
+}
+
+// A few hot symbols get most of the ticks (Zipf, s = 1.1), prices random walk.
+inline std::vector<Quote> Zipf(size_t aSymbols, size_t aTicks, unsigned aSeed)
+{
+    std::mt19937 random(aSeed);
+    std::uniform_real_distribution<double> uniform(0, 1);
+    std::normal_distribution<double> moves(0, 0.002);
+
+    std::vector<double> cdf(aSymbols);
+    for (size_t i = 0; i < aSymbols; ++i)
+    {
+        cdf[i] = (i ? cdf[i - 1] : 0) + 1 / std::pow(i + 1, 1.1);
+    }
+
+    // The ranks are shuffled over the ids, so the hot symbols are not the smallest ids.
+    std::vector<TId> ids(aSymbols);
+    std::iota(ids.begin(), ids.end(), 1);
+    std::shuffle(ids.begin(), ids.end(), random);
+
+    auto quotes = details::Open(aSymbols, aTicks);
+    std::vector<double> prices(aSymbols + 1);
+    for (size_t i = 1; i <= aSymbols; ++i)
+    {
+        prices[i] = details::BasePrice(static_cast<TId>(i));
+    }
+
+    for (size_t i = 0; i < aTicks; ++i)
+    {
+        size_t rank = std::lower_bound(cdf.begin(), cdf.end(), uniform(random) * cdf.back()) - cdf.begin();
+        TId id = ids[std::min(rank, aSymbols - 1)];
+        prices[id] *= 1 + moves(random);
+        quotes.push_back({id, prices[id]});
+    }
+    return quotes;
+}
+
+// Every symbol drifts up at its own pace, the ranking changes slowly.
+inline std::vector<Quote> Trend(size_t aSymbols, size_t aTicks, unsigned aSeed)
+{
+    std::mt19937 random(aSeed);
+    std::uniform_int_distribution<TId> ids(1, static_cast<TId>(aSymbols));
+    std::normal_distribution<double> noise(0, 0.0005);
+
+    auto quotes = details::Open(aSymbols, aTicks);
+    std::vector<double> prices(aSymbols + 1);
+    std::vector<double> drifts(aSymbols + 1);
+    for (size_t i = 1; i <= aSymbols; ++i)
+    {
+        prices[i] = details::BasePrice(static_cast<TId>(i));
+        drifts[i] = 0.0001 * (i % 100) / 100;
+    }
+
+    for (size_t i = 0; i < aTicks; ++i)
+    {
+        TId id = ids(random);
+        prices[id] *= 1 + drifts[id] + noise(random);
+        quotes.push_back({id, prices[id]});
+    }
+    return quotes;
+}
+
+// Market-wide swings: in turn every symbol falls by about 20% and recovers, visited in a random order.
+// The top rankers leave the charts together, which forces repeated restores.
+inline std::vector<Quote> Crash(size_t aSymbols, size_t aTicks, unsigned aSeed)
+{
+    std::mt19937 random(aSeed);
+    std::uniform_real_distribution<double> moves(0.95, 1.05);
+
+    auto quotes = details::Open(aSymbols, aTicks);
+    std::vector<TId> ids(aSymbols);
+    std::iota(ids.begin(), ids.end(), 1);
+
+    bool isFalling = true;
+    while (quotes.size() < aSymbols + aTicks)
+    {
+        std::shuffle(ids.begin(), ids.end(), random);
+        for (size_t i = 0; i < ids.size() && quotes.size() < aSymbols + aTicks; ++i)
+        {
+            quotes.push_back({ids[i], details::BasePrice(ids[i]) * (isFalling ? 0.8 : 1) * moves(random)});
+        }
+        isFalling = !isFalling;
+    }
+    return quotes;
+}
+
+// The open: most ticks repeat the base price, all the symbols tie at 0%, a few start to move.
+inline std::vector<Quote> OpenTies(size_t aSymbols, size_t aTicks, unsigned aSeed)
+{
+    std::mt19937 random(aSeed);
+    std::uniform_int_distribution<TId> ids(1, static_cast<TId>(aSymbols));
+    std::uniform_int_distribution<int> moves(-3, 3);
+    std::bernoulli_distribution isMoving(0.05);
+
+    auto quotes = details::Open(aSymbols, aTicks);
+    for (size_t i = 0; i < aTicks; ++i)
+    {
+        TId id = ids(random);
+        double price = details::BasePrice(id);
+        quotes.push_back({id, isMoving(random) ? price * (1 + moves(random) / 1000.) : price});
+    }
+    return quotes;
+}
+
+inline std::vector<Scenario> Scenarios()
+{
+    return {
+        {"uniform", Uniform},
+        {"zipf", Zipf},
+        {"trend", Trend},
+        {"crash", Crash},
+        {"open-ties", OpenTies},
+    };
+}
+
+}
+}
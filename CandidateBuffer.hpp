@@ -0,0 +1,136 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <utility>
+
+#include "ITopStocks.hpp"
+
+namespace top_stocks
+{
+
+// Fixed-capacity sorted set of (change, id) pairs stored inline in two arrays, best elements first.
+// The insert position is found by counting the better elements over the whole fixed-size arrays without
+// branches, which the compiler vectorizes; there is no allocation after construction.
+// The number of kept elements may be limited below the capacity at runtime.
+template <template <typename> typename TComparator, size_t Capacity>
+struct CandidateBuffer
+{
+    using TElement = std::pair<TChange, TId>;
+
+    size_t Size() const
+    {
+        return mSize;
+    }
+
+    bool IsFull() const
+    {
+        return mSize == mLimit;
+    }
+
+    size_t Limit() const
+    {
+        return mLimit;
+    }
+
+    // The worst elements over the new limit are dropped.
+    void SetLimit(size_t aLimit)
+    {
+        assert(0 < aLimit && aLimit <= Capacity);
+        mLimit = aLimit;
+        mSize = std::min(mSize, mLimit);
+    }
+
+    // Copies the best elements of the other buffer keeping the own limit.
+    void Assign(const CandidateBuffer& aOther)
+    {
+        mSize = std::min(aOther.mSize, mLimit);
+        std::copy_n(aOther.mChanges.begin(), mSize, mChanges.begin());
+        std::copy_n(aOther.mIds.begin(), mSize, mIds.begin());
+    }
+
+    TElement operator[](size_t aIndex) const
+    {
+        assert(aIndex < mSize);
+        return {mChanges[aIndex], mIds[aIndex]};
+    }
+
+    TElement Back() const
+    {
+        return (*this)[mSize - 1];
+    }
+
+    const TChange* Changes() const
+    {
+        return mChanges.data();
+    }
+
+    const TId* Ids() const
+    {
+        return mIds.data();
+    }
+
+    void Clear()
+    {
+        mSize = 0;
+    }
+
+    // Keeps the order. If the buffer is full the worst element, which may be the inserted one, is dropped
+    // and true is returned.
+    bool Insert(TChange aChange, TId aId)
+    {
+        size_t position = Position(aChange, aId);
+        if (position == mLimit)
+        {
+            return true;
+        }
+
+        bool isDropped = IsFull();
+        size_t last = isDropped ? mLimit - 1 : mSize++;
+        std::copy_backward(mChanges.begin() + position, mChanges.begin() + last, mChanges.begin() + last + 1);
+        std::copy_backward(mIds.begin() + position, mIds.begin() + last, mIds.begin() + last + 1);
+        mChanges[position] = aChange;
+        mIds[position] = aId;
+        return isDropped;
+    }
+
+    // Returns false if there is no such element.
+    bool Erase(TChange aChange, TId aId)
+    {
+        size_t position = Position(aChange, aId);
+        if (position == mSize || mChanges[position] != aChange || mIds[position] != aId)
+        {
+            return false;
+        }
+
+        std::copy(mChanges.begin() + position + 1, mChanges.begin() + mSize, mChanges.begin() + position);
+        std::copy(mIds.begin() + position + 1, mIds.begin() + mSize, mIds.begin() + position);
+        --mSize;
+        return true;
+    }
+
+    // The number of elements better than the given one.
+    size_t Position(TChange aChange, TId aId) const
+    {
+        const TComparator<TChange> changeComparator;
+        const TComparator<TId> idComparator;
+
+        size_t position = 0;
+        for (size_t i = 0; i < Capacity; ++i)
+        {
+            position += (i < mSize)
+                & (changeComparator(mChanges[i], aChange) | ((mChanges[i] == aChange) & idComparator(mIds[i], aId)));
+        }
+        return position;
+    }
+
+private:
+
+    std::array<TChange, Capacity> mChanges {};
+    std::array<TId, Capacity> mIds {};
+    size_t mSize = 0;
+    size_t mLimit = Capacity;
+};
+
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include "ITopStocks.hpp"
+#include "QuoteStore.hpp"
+
+namespace top_stocks
+{
+
+// How the change of a stock is computed from its base and its last price. The per-stock scale is computed
+// once per base, the change once per quote. PerPercent is the number of change units in one percent.
+
+// Changes in percent as (price - base) / base * 100, the scale is the base itself.
+struct PercentChange
+{
+    using TScale = TBase;
+
+    static const constexpr std::uint32_t PerPercent = 1;
+
+    static TScale Scale(TBase aBase)
+    {
+        return aBase;
+    }
+
+    static TChange Change(double aPrice, TScale aScale)
+    {
+        return (aPrice - aScale) / aScale * 100;
+    }
+};
+
+// Fixed-point changes in whole basis points, rounded to the nearest one. Prices are rounded to integer ticks
+// of 1 / TicksPerUnit and the scale caches the base ticks along with a 32.32 multiplier of 10000 / base, so a
+// change costs a multiply and a shift instead of a division. Changes are integral, which makes comparisons
+// and ties exact; they are still kept and notified as TChange values, in basis points.
+template <std::int64_t TicksPerUnit = 10000>
+struct BasisPointChange
+{
+    struct TScale
+    {
+        std::int64_t BaseTicks;
+        std::int64_t Multiplier;
+    };
+
+    static const constexpr std::uint32_t PerPercent = 100;
+
+    static TScale Scale(TBase aBase)
+    {
+        std::int64_t ticks = std::max<std::int64_t>(Ticks(aBase), 1);
+        // Rounded up, so that exact changes are not truncated by the shift.
+        return {ticks, ((std::int64_t(10000) << Shift) + ticks - 1) / ticks};
+    }
+
+    // Does not overflow for changes below 2^31 basis points.
+    static TChange Change(double aPrice, const TScale& aScale)
+    {
+        std::int64_t difference = Ticks(aPrice) - aScale.BaseTicks;
+        return static_cast<TChange>((difference * aScale.Multiplier + (std::int64_t(1) << (Shift - 1))) >> Shift);
+    }
+
+private:
+
+    static const constexpr int Shift = 32;
+
+    static std::int64_t Ticks(double aPrice)
+    {
+        return static_cast<std::int64_t>(aPrice * TicksPerUnit + 0.5);
+    }
+};
+
+// The scales of the stocks by slot of a quote store, set along with their bases. A percent change is scaled by
+// the base column itself, other scales are kept in their own column.
+template <typename TChangeModel>
+struct ScaleColumn
+{
+    using TScale = typename TChangeModel::TScale;
+
+    static const constexpr bool IsBaseScale = std::is_same<TScale, TBase>::value;
+
+    TScale Scale(const QuoteStore& aQuotes, QuoteStore::TSlot aSlot) const
+    {
+        if constexpr (IsBaseScale)
+        {
+            return aQuotes.Base(aSlot);
+        }
+        else
+        {
+            return mScales[aSlot];
+        }
+    }
+
+    void SetBase(QuoteStore& aQuotes, QuoteStore::TSlot aSlot, TBase aBase)
+    {
+        aQuotes.Base(aSlot) = aBase;
+        if constexpr (!IsBaseScale)
+        {
+            if (mScales.size() <= aSlot)
+            {
+                mScales.resize(aSlot + 1);
+            }
+            mScales[aSlot] = TChangeModel::Scale(aBase);
+        }
+    }
+
+    void Clear()
+    {
+        mScales.clear();
+    }
+
+private:
+
+    std::vector<TScale> mScales;
+};
+
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <chrono>
+
+namespace top_stocks
+{
+
+using TDuration = std::chrono::nanoseconds;
+using TTimePoint = std::chrono::time_point<std::chrono::steady_clock, TDuration>;
+
+struct IClock
+{
+    virtual ~IClock() = default;
+
+    virtual TTimePoint Now() const = 0;
+};
+
+struct SteadyClock : IClock
+{
+    TTimePoint Now() const override
+    {
+        return std::chrono::time_point_cast<TDuration>(std::chrono::steady_clock::now());
+    }
+
+    static const SteadyClock& Instance()
+    {
+        static const SteadyClock clock;
+        return clock;
+    }
+};
+
+}
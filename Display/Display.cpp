@@ -1,73 +1,90 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <ctime>
 #include <cstdlib>
-#include <string>
-#include <vector>
 #include <iostream>
 #include <thread>
 
 #include "../TopStocks.hpp"
+#include "TerminalRenderer.hpp"
+#include "TripleBuffer.hpp"
 
+// The callbacks only publish the lists and return, a render thread draws the latest ones at its own pace:
+// once per frame interval, and a last time when the display is destroyed.
 struct Display : top_stocks::ITopStocksHandler
 {
-    Display()
-        : mGainers{"Top Gainers:"}
-        , mLosers{"Top Losers:"}
+    explicit Display(top_stocks::TDuration aFrameInterval)
+        : mFrameInterval(aFrameInterval)
+        // The render thread paces the frames itself.
+        , mRenderer(top_stocks::TopSize, top_stocks::TDuration::zero())
+        , mThread(&Display::Run, this)
     {
-        mGainers.resize(11);
-        mLosers.resize(11);
+
     }
 
-    void ProcessTopGainersChanged(const top_stocks::TTopList& aContainer) override
+    ~Display()
     {
-        for (size_t i = 0; i < aContainer.size(); ++i)
-        {
-            mGainers[i + 1] =
-                "#" + std::to_string(i + 1) + " "
-                + std::to_string(aContainer[i].first) + " "
-                + std::to_string(aContainer[i].second);
-        }
+        mIsStopped.store(true, std::memory_order_release);
+        mThread.join();
+    }
 
-        Print();
+    void ProcessTopGainersChanged(const top_stocks::TTopList& aContainer) override
+    {
+        mGainers.Publish(aContainer);
     }
 
     void ProcessTopLosersChanged(const top_stocks::TTopList& aContainer) override
     {
-        for (size_t i = 0; i < aContainer.size(); ++i)
-        {
-            mLosers[i + 1] =
-                "#" + std::to_string(i + 1) + " "
-                + std::to_string(aContainer[i].first) + " "
-                + std::to_string(aContainer[i].second);
-        }
-
-        Print();
+        mLosers.Publish(aContainer);
     }
 
 private:
 
-    void Print() const
+    using TRenderer = top_stocks::display::TerminalRenderer;
+
+    void Run()
     {
-        for (const auto& e : mGainers)
-        {
-            std::cout << e << std::endl;
-        }
-        std::cout << std::endl;
-        for (const auto& e : mLosers)
+        while (true)
         {
-            std::cout << e << std::endl;
+            // The lists published before the stop are drawn by the last frame.
+            bool isStopped = mIsStopped.load(std::memory_order_acquire);
+
+            if (mGainers.Update())
+            {
+                mRenderer.SetTop(TRenderer::Gainers, mGainers.Latest());
+            }
+            if (mLosers.Update())
+            {
+                mRenderer.SetTop(TRenderer::Losers, mLosers.Latest());
+            }
+            mRenderer.Poll();
+
+            if (isStopped)
+            {
+                return;
+            }
+            std::this_thread::sleep_for(mFrameInterval);
         }
-        std::cout << std::endl;
     }
 
-    std::vector<std::string> mGainers;
-    std::vector<std::string> mLosers;
+    const top_stocks::TDuration mFrameInterval;
+    TRenderer mRenderer;
+
+    top_stocks::display::TripleBuffer<top_stocks::TTopList> mGainers;
+    top_stocks::display::TripleBuffer<top_stocks::TTopList> mLosers;
+    std::atomic<bool> mIsStopped {};
+
+    std::thread mThread;
 };
 
+// Usage: Display [max frames per second]
 int main(int argc, char *argv[])
 {
     std::cout << "Welcome to Top Stocks Display!" << std::endl;
 
-    Display display;
+    int framesPerSecond = argc > 1 ? std::max(std::atoi(argv[1]), 1) : 30;
+    Display display(std::chrono::duration_cast<top_stocks::TDuration>(std::chrono::seconds(1)) / framesPerSecond);
     top_stocks::TopStocks topStocks(display);
 
     for (size_t i = 0; i < 10000; ++i)
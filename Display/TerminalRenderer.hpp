@@ -0,0 +1,216 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "../Clock.hpp"
+#include "../ITopStocks.hpp"
+
+namespace top_stocks
+{
+
+namespace display
+{
+
+// Draws the gainers and the losers tables into a frame buffer allocated once. Every row has a fixed slot,
+// so updating a row formats it in place with to_chars. A frame redraws the terminal from the top left
+// corner with ANSI control sequences and is written with a single write call to the output, the standard
+// output by default, at most once per interval.
+struct TerminalRenderer
+{
+    enum Side
+    {
+        Gainers,
+        Losers,
+    };
+
+    TerminalRenderer(size_t aRows, TDuration aFrameInterval, const IClock& aClock = SteadyClock::Instance(),
+        int aOutput = 1)
+        : mRows(aRows)
+        , mFrameInterval(aFrameInterval)
+        , mClock(aClock)
+        , mOutput(aOutput)
+    {
+        Append(ClearScreen);
+        Append(Home);
+        AppendTitle("Top Gainers:");
+        mRowsOffset[Gainers] = mFrame.size();
+        mFrame.resize(mFrame.size() + mRows * RowWidth);
+        AppendTitle("");
+        AppendTitle("Top Losers:");
+        mRowsOffset[Losers] = mFrame.size();
+        mFrame.resize(mFrame.size() + mRows * RowWidth);
+        AppendTitle("");
+
+        for (size_t i = 0; i < mRows; ++i)
+        {
+            ClearRow(Gainers, i);
+            ClearRow(Losers, i);
+        }
+    }
+
+    void SetRow(Side aSide, size_t aPosition, TId aStockId, TChange aChange)
+    {
+        char* row = Row(aSide, aPosition);
+        std::memset(row, ' ', RowWidth);
+
+        row[0] = '#';
+        std::to_chars(row + 1, row + PositionWidth, aPosition + 1);
+        Format(row + PositionWidth, IdWidth, aStockId);
+        Format(row + PositionWidth + IdWidth, ChangeWidth, aChange);
+        Terminate(row);
+        mIsDirty = true;
+    }
+
+    void ClearRow(Side aSide, size_t aPosition)
+    {
+        char* row = Row(aSide, aPosition);
+        std::memset(row, ' ', RowWidth);
+        Terminate(row);
+        mIsDirty = true;
+    }
+
+    void SetTop(Side aSide, Span<const TQuote> aTop)
+    {
+        for (size_t i = 0; i < std::min(aTop.size(), mRows); ++i)
+        {
+            if (aTop[i].first)
+            {
+                SetRow(aSide, i, aTop[i].first, aTop[i].second);
+            }
+            else
+            {
+                ClearRow(aSide, i);
+            }
+        }
+    }
+
+    // Draws the pending changes unless a frame was drawn within the interval.
+    void Poll()
+    {
+        if (!mIsDirty)
+        {
+            return;
+        }
+
+        auto now = mClock.Now();
+        if (mLastFrame + mFrameInterval > now)
+        {
+            return;
+        }
+        mLastFrame = now;
+        mIsDirty = false;
+
+        // The screen is cleared by the first frame only.
+        size_t offset = mIsCleared ? std::strlen(ClearScreen) : 0;
+        mIsCleared = true;
+        Write(mFrame.data() + offset, mFrame.size() - offset);
+    }
+
+    // The whole frame, the screen clearing sequence included.
+    const std::vector<char>& Frame() const
+    {
+        return mFrame;
+    }
+
+private:
+
+    static const constexpr char* ClearScreen = "\x1b[2J";
+    static const constexpr char* Home = "\x1b[H";
+    static const constexpr char* LineEnd = "\x1b[K\n";
+
+    static const constexpr size_t PositionWidth = 4;
+    static const constexpr size_t IdWidth = 12;
+    static const constexpr size_t ChangeWidth = 16;
+    static const constexpr size_t RowWidth = PositionWidth + IdWidth + ChangeWidth + 4;
+
+    void Append(const char* aText)
+    {
+        mFrame.insert(mFrame.end(), aText, aText + std::strlen(aText));
+    }
+
+    void AppendTitle(const char* aTitle)
+    {
+        Append(aTitle);
+        Append(LineEnd);
+    }
+
+    char* Row(Side aSide, size_t aPosition)
+    {
+        return mFrame.data() + mRowsOffset[aSide] + aPosition * RowWidth;
+    }
+
+    static void Terminate(char* aRow)
+    {
+        std::memcpy(aRow + RowWidth - std::strlen(LineEnd), LineEnd, std::strlen(LineEnd));
+    }
+
+    // Right aligned within the width, truncated if too long. A value too long to be formatted at all is shown
+    // as asterisks.
+    template <typename T>
+    static void Format(char* aField, size_t aWidth, T aValue)
+    {
+        char text[32];
+        std::to_chars_result result {};
+        if constexpr (std::is_floating_point<T>::value)
+        {
+            result = std::to_chars(text, text + sizeof(text), aValue, std::chars_format::fixed, 6);
+        }
+        else
+        {
+            result = std::to_chars(text, text + sizeof(text), aValue);
+        }
+
+        if (result.ec != std::errc())
+        {
+            std::memset(aField + 1, '*', aWidth - 1);
+            return;
+        }
+
+        size_t size = std::min<size_t>(result.ptr - text, aWidth - 1);
+        std::memcpy(aField + aWidth - size, text, size);
+    }
+
+    void Write(const char* aData, size_t aSize) const
+    {
+        while (aSize)
+        {
+#ifdef _WIN32
+            auto written = ::_write(mOutput, aData, static_cast<unsigned>(aSize));
+#else
+            auto written = ::write(mOutput, aData, aSize);
+#endif
+            if (written <= 0)
+            {
+                return;
+            }
+            aData += written;
+            aSize -= static_cast<size_t>(written);
+        }
+    }
+
+    const size_t mRows;
+    const TDuration mFrameInterval;
+    const IClock& mClock;
+    const int mOutput;
+
+    std::vector<char> mFrame;
+    size_t mRowsOffset[2] {};
+
+    bool mIsDirty = false;
+    bool mIsCleared = false;
+    TTimePoint mLastFrame = TTimePoint::min();
+};
+
+}
+}
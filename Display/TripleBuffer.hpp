@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace top_stocks
+{
+
+namespace display
+{
+
+// Hands the latest value from one writer thread to one reader thread without locks or waiting.
+// The writer fills its own buffer and swaps it with the middle one, the reader swaps the middle one with
+// its own buffer only if the middle one holds a newer value. Values overwritten before being read are lost.
+template <typename T>
+struct TripleBuffer
+{
+    static const constexpr size_t CacheLineSize = 64;
+
+    // Writer side.
+    void Publish(const T& aValue)
+    {
+        mBuffers[mBack].mValue = aValue;
+        mBack = mMiddle.exchange(mBack | Fresh, std::memory_order_acq_rel) & Index;
+    }
+
+    // Reader side. Returns true if a newer value was published since the previous call.
+    bool Update()
+    {
+        if (!(mMiddle.load(std::memory_order_relaxed) & Fresh))
+        {
+            return false;
+        }
+
+        mFront = mMiddle.exchange(mFront, std::memory_order_acq_rel) & Index;
+        return true;
+    }
+
+    // Reader side. The value taken by the last Update.
+    const T& Latest() const
+    {
+        return mBuffers[mFront].mValue;
+    }
+
+private:
+
+    static const constexpr std::uint8_t Index = 3;
+    static const constexpr std::uint8_t Fresh = 4;
+
+    struct alignas(CacheLineSize) Buffer
+    {
+        T mValue {};
+    };
+
+    Buffer mBuffers[3];
+
+    alignas(CacheLineSize) std::atomic<std::uint8_t> mMiddle {1};
+    alignas(CacheLineSize) std::uint8_t mBack = 0;
+    alignas(CacheLineSize) std::uint8_t mFront = 2;
+};
+
+}
+}
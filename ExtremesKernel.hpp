@@ -0,0 +1,179 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <utility>
+
+#include "ITopStocks.hpp"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define TOP_STOCKS_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(TOP_STOCKS_X86) && (defined(__GNUC__) || defined(__clang__))
+#define TOP_STOCKS_TARGET(aTarget) __attribute__((target(aTarget)))
+#else
+#define TOP_STOCKS_TARGET(aTarget)
+#endif
+
+namespace top_stocks
+{
+
+// Selects the best gainers and the worst losers of contiguous change and id columns in one pass.
+// The vector variants compare a block of changes against both current bars at once and fall back to the
+// exact (change, id) comparison only for the lanes which may enter a candidate set, ties included.
+// The variant is chosen at runtime: AVX2, SSE2 or scalar.
+template <typename TGainers, typename TLosers>
+struct ExtremesKernel
+{
+    using TFunction = void (*)(const TChange*, const TId*, size_t, TGainers&, TLosers&);
+
+    static void Run(const TChange* aChanges, const TId* aIds, size_t aSize, TGainers& aGainers, TLosers& aLosers)
+    {
+        static const TFunction function = Choose();
+        function(aChanges, aIds, aSize, aGainers, aLosers);
+    }
+
+    static void Scalar(const TChange* aChanges, const TId* aIds, size_t aSize, TGainers& aGainers, TLosers& aLosers)
+    {
+        for (size_t i = 0; i < aSize; ++i)
+        {
+            Offer(aChanges[i], aIds[i], aGainers, aLosers);
+        }
+    }
+
+#ifdef TOP_STOCKS_X86
+    TOP_STOCKS_TARGET("sse2")
+    static void Sse2(const TChange* aChanges, const TId* aIds, size_t aSize, TGainers& aGainers, TLosers& aLosers)
+    {
+        __m128d gainersBar = _mm_set1_pd(GainersBar(aGainers));
+        __m128d losersBar = _mm_set1_pd(LosersBar(aLosers));
+
+        size_t i = 0;
+        for (; i + 2 <= aSize; i += 2)
+        {
+            __m128d changes = _mm_loadu_pd(aChanges + i);
+            __m128d mask = _mm_or_pd(_mm_cmpge_pd(changes, gainersBar), _mm_cmple_pd(changes, losersBar));
+            if (_mm_movemask_pd(mask))
+            {
+                Offer(aChanges[i], aIds[i], aGainers, aLosers);
+                Offer(aChanges[i + 1], aIds[i + 1], aGainers, aLosers);
+                gainersBar = _mm_set1_pd(GainersBar(aGainers));
+                losersBar = _mm_set1_pd(LosersBar(aLosers));
+            }
+        }
+
+        Scalar(aChanges + i, aIds + i, aSize - i, aGainers, aLosers);
+    }
+
+    TOP_STOCKS_TARGET("avx2")
+    static void Avx2(const TChange* aChanges, const TId* aIds, size_t aSize, TGainers& aGainers, TLosers& aLosers)
+    {
+        __m256d gainersBar = _mm256_set1_pd(GainersBar(aGainers));
+        __m256d losersBar = _mm256_set1_pd(LosersBar(aLosers));
+
+        size_t i = 0;
+        for (; i + 4 <= aSize; i += 4)
+        {
+            __m256d changes = _mm256_loadu_pd(aChanges + i);
+            __m256d mask = _mm256_or_pd(
+                _mm256_cmp_pd(changes, gainersBar, _CMP_GE_OQ), _mm256_cmp_pd(changes, losersBar, _CMP_LE_OQ));
+            if (_mm256_movemask_pd(mask))
+            {
+                for (size_t j = i; j < i + 4; ++j)
+                {
+                    Offer(aChanges[j], aIds[j], aGainers, aLosers);
+                }
+                gainersBar = _mm256_set1_pd(GainersBar(aGainers));
+                losersBar = _mm256_set1_pd(LosersBar(aLosers));
+            }
+        }
+
+        Scalar(aChanges + i, aIds + i, aSize - i, aGainers, aLosers);
+    }
+#else
+    // Never chosen off x86, where the feature checks fail; kept so that the variants can be named anywhere.
+    static void Sse2(const TChange* aChanges, const TId* aIds, size_t aSize, TGainers& aGainers, TLosers& aLosers)
+    {
+        Scalar(aChanges, aIds, aSize, aGainers, aLosers);
+    }
+
+    static void Avx2(const TChange* aChanges, const TId* aIds, size_t aSize, TGainers& aGainers, TLosers& aLosers)
+    {
+        Scalar(aChanges, aIds, aSize, aGainers, aLosers);
+    }
+#endif
+
+    static bool IsSse2Supported()
+    {
+#if defined(TOP_STOCKS_X86) && (defined(__GNUC__) || defined(__clang__))
+        return __builtin_cpu_supports("sse2");
+#elif defined(TOP_STOCKS_X86) && defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 1);
+        return (info[3] & (1 << 26)) != 0;
+#else
+        return false;
+#endif
+    }
+
+    static bool IsAvx2Supported()
+    {
+#if defined(TOP_STOCKS_X86) && (defined(__GNUC__) || defined(__clang__))
+        return __builtin_cpu_supports("avx2");
+#elif defined(TOP_STOCKS_X86) && defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 1);
+        const bool isOsSaving = (info[2] & (1 << 27)) && (info[2] & (1 << 28))
+            && (_xgetbv(0) & 6) == 6;
+        __cpuidex(info, 7, 0);
+        return isOsSaving && (info[1] & (1 << 5));
+#else
+        return false;
+#endif
+    }
+
+private:
+
+    static TFunction Choose()
+    {
+        if (IsAvx2Supported())
+        {
+            return &Avx2;
+        }
+        return IsSse2Supported() ? &Sse2 : &Scalar;
+    }
+
+    static TChange GainersBar(const TGainers& aGainers)
+    {
+        return aGainers.IsFull() ? aGainers.Back().first : -std::numeric_limits<TChange>::infinity();
+    }
+
+    static TChange LosersBar(const TLosers& aLosers)
+    {
+        return aLosers.IsFull() ? aLosers.Back().first : std::numeric_limits<TChange>::infinity();
+    }
+
+    static void Offer(TChange aChange, TId aId, TGainers& aGainers, TLosers& aLosers)
+    {
+        const std::pair<TChange, TId> e {aChange, aId};
+        if (!aGainers.IsFull() || std::greater<std::pair<TChange, TId>>()(e, aGainers.Back()))
+        {
+            aGainers.Insert(aChange, aId);
+        }
+        if (!aLosers.IsFull() || std::less<std::pair<TChange, TId>>()(e, aLosers.Back()))
+        {
+            aLosers.Insert(aChange, aId);
+        }
+    }
+};
+
+}
+
+#undef TOP_STOCKS_TARGET
+#undef TOP_STOCKS_X86
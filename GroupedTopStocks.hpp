@@ -0,0 +1,283 @@
+#pragma once
+
+#include <cassert>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Clock.hpp"
+#include "TopStocks.hpp"
+
+namespace top_stocks
+{
+
+using TGroupId = int;
+
+template <size_t K>
+struct IBasicGroupTopStocksHandler
+{
+    using TTopList = TBasicTopList<K>;
+
+    virtual ~IBasicGroupTopStocksHandler() = default;
+
+    virtual void ProcessGroupTopGainersChanged(TGroupId aGroupId, const TTopList&) = 0;
+
+    virtual void ProcessGroupTopLosersChanged(TGroupId aGroupId, const TTopList&) = 0;
+};
+
+using IGroupTopStocksHandler = IBasicGroupTopStocksHandler<TopSize>;
+
+// Top gainers and losers of every group of stocks, e.g. sectors or index memberships; a stock may belong to
+// several groups. The bases and changes are kept once per stock, a quote updates them once and then only the
+// groups of the stock. Every group keeps the changes of its members in its own contiguous columns along with
+// its own candidate sets, so restoring a group scans its members only. The changes are computed by the change
+// model, in percent by default.
+template <size_t K = TopSize, size_t Capacity = DefaultTopCapacity<K>, typename TChangeModel = PercentChange>
+struct BasicGroupedTopStocks : ITopStocks
+{
+    using THandler = IBasicGroupTopStocksHandler<K>;
+    using TTopList = TBasicTopList<K>;
+
+    BasicGroupedTopStocks(THandler& aHandler, TId aDenseIdLimit = QuoteStore::DefaultDenseLimit,
+        const IClock& aClock = SteadyClock::Instance())
+        : mHandler(aHandler)
+        , mClock(aClock)
+        , mQuotes(aDenseIdLimit)
+    {
+
+    }
+
+    // The stock is ranked in the group from now on, at once if it was quoted, otherwise from its first quote.
+    void AddToGroup(TId aStockId, TGroupId aGroupId)
+    {
+        assert(aStockId > 0);
+
+        size_t group = FindOrAddGroup(aGroupId);
+        auto slot = mQuotes.Find(aStockId);
+        if (slot == QuoteStore::NoSlot)
+        {
+            mPendingMemberships[aStockId].push_back(group);
+            return;
+        }
+
+        Join(slot, group);
+    }
+
+    size_t GroupsCount() const
+    {
+        return mGroups.size();
+    }
+
+    void OnQuote(int aStockId, double aPrice) override
+    {
+        Apply(aStockId, aPrice);
+    }
+
+    // Every group notifies its tops once per batch.
+    void OnQuotes(Span<const Quote> aQuotes) override
+    {
+        for (auto& group : mGroups)
+        {
+            group->Gainers.BeginBatch();
+            group->Losers.BeginBatch();
+        }
+
+        for (const auto& quote : aQuotes)
+        {
+            Apply(quote.StockId, quote.Price);
+        }
+
+        for (auto& group : mGroups)
+        {
+            group->Gainers.EndBatch();
+            group->Losers.EndBatch();
+        }
+    }
+
+private:
+
+    struct GainersNotifier
+    {
+        void operator()(const TTopList& aTop) const
+        {
+            mHandler->ProcessGroupTopGainersChanged(mGroupId, aTop);
+        }
+
+        // The deltas are not enabled for groups.
+        void operator()(const TTopList& aTop, Span<const TopChange>) const
+        {
+            (*this)(aTop);
+        }
+
+        THandler* mHandler;
+        TGroupId mGroupId;
+    };
+
+    struct LosersNotifier
+    {
+        void operator()(const TTopList& aTop) const
+        {
+            mHandler->ProcessGroupTopLosersChanged(mGroupId, aTop);
+        }
+
+        void operator()(const TTopList& aTop, Span<const TopChange>) const
+        {
+            (*this)(aTop);
+        }
+
+        THandler* mHandler;
+        TGroupId mGroupId;
+    };
+
+    struct Group
+    {
+        Group(THandler& aHandler, TGroupId aId, const IClock& aClock)
+            : Members(0)
+            , Selector(Members)
+            , Gainers(std::numeric_limits<TChange>::min(), GainersNotifier {&aHandler, aId}, aClock)
+            , Losers(std::numeric_limits<TChange>::max(), LosersNotifier {&aHandler, aId}, aClock)
+        {
+            // Members joining a group at 0% tie with its quiet members.
+            Gainers.EnableTieNotifications(true);
+            Losers.EnableTieNotifications(true);
+        }
+
+        // The selector refers to the members of the instance.
+        Group(const Group&) = delete;
+        Group(Group&&) = delete;
+        Group& operator=(const Group&) = delete;
+        Group& operator=(Group&&) = delete;
+
+        // The member ids and changes, the bases are not used. Ids are resolved only when joining.
+        QuoteStore Members;
+        TopSelector<Capacity> Selector;
+        TopProcessor<std::greater, K, Capacity, GainersNotifier> Gainers;
+        TopProcessor<std::less, K, Capacity, LosersNotifier> Losers;
+    };
+
+    struct Membership
+    {
+        size_t Group;
+        QuoteStore::TSlot Member;
+    };
+
+    size_t FindOrAddGroup(TGroupId aGroupId)
+    {
+        auto it = mGroupIndex.find(aGroupId);
+        if (it != mGroupIndex.end())
+        {
+            return it->second;
+        }
+
+        mGroups.push_back(std::make_unique<Group>(mHandler, aGroupId, mClock));
+        mGroupIndex.emplace(aGroupId, mGroups.size() - 1);
+        return mGroups.size() - 1;
+    }
+
+    void Join(QuoteStore::TSlot aSlot, size_t aGroup)
+    {
+        auto& group = *mGroups[aGroup];
+        auto id = mQuotes.Id(aSlot);
+        if (group.Members.Find(id) != QuoteStore::NoSlot)
+        {
+            return;
+        }
+
+        auto change = mQuotes.Change(aSlot);
+        mMemberships[aSlot].push_back({aGroup, group.Members.Insert(id, 0, change)});
+        // The new member is not among the candidates, so there is nothing to erase.
+        Publish(group, id, change, change);
+    }
+
+    void Apply(TId aStockId, double aPrice)
+    {
+        if (aStockId <= 0)
+        {
+            return;
+        }
+
+        TChange oldPercent = 0;
+
+        auto slot = mQuotes.Find(aStockId);
+        if (slot == QuoteStore::NoSlot)
+        {
+            if (aPrice <= 0)
+            {
+                return;
+            }
+
+            slot = mQuotes.Insert(aStockId, aPrice, 0.);
+            mScales.SetBase(mQuotes, slot, aPrice);
+            mMemberships.emplace_back();
+
+            auto pending = mPendingMemberships.find(aStockId);
+            if (pending != mPendingMemberships.end())
+            {
+                for (auto group : pending->second)
+                {
+                    Join(slot, group);
+                }
+                mPendingMemberships.erase(pending);
+            }
+            return;
+        }
+
+        auto& change = mQuotes.Change(slot);
+
+        if (aPrice <= 0)
+        {
+            mScales.SetBase(mQuotes, slot, 0);
+        }
+
+        if (mQuotes.Base(slot))
+        {
+            oldPercent = std::exchange(change, TChangeModel::Change(aPrice, mScales.Scale(mQuotes, slot)));
+        }
+        else
+        {
+            oldPercent = std::exchange(change, 0);
+        }
+
+        for (const auto& membership : mMemberships[slot])
+        {
+            auto& group = *mGroups[membership.Group];
+            group.Members.Change(membership.Member) = change;
+            Publish(group, aStockId, oldPercent, change);
+        }
+    }
+
+    void Publish(Group& aGroup, TId aStockId, TChange aOldPercent, TChange aNewPercent)
+    {
+        aGroup.Selector.Invalidate();
+
+        if (aGroup.Members.Size() <= K)
+        {
+            aGroup.Gainers.Copy(aGroup.Members);
+            aGroup.Losers.Copy(aGroup.Members);
+        }
+        else
+        {
+            aGroup.Gainers.Process(aStockId, aOldPercent, aNewPercent, aGroup.Selector);
+            aGroup.Losers.Process(aStockId, aOldPercent, aNewPercent, aGroup.Selector);
+        }
+    }
+
+    THandler& mHandler;
+    const IClock& mClock;
+
+    QuoteStore mQuotes;
+    ScaleColumn<TChangeModel> mScales;
+    // The groups of every stock with its slots there, by stock slot.
+    std::vector<std::vector<Membership>> mMemberships;
+    std::unordered_map<TId, std::vector<size_t>> mPendingMemberships;
+
+    std::vector<std::unique_ptr<Group>> mGroups;
+    std::unordered_map<TGroupId, size_t> mGroupIndex;
+};
+
+using GroupedTopStocks = BasicGroupedTopStocks<TopSize, TopMaxCapacity>;
+
+}
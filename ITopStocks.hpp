@@ -1,6 +1,7 @@
 #pragma once
 
 #include <array>
+#include <cstddef>
 #include <utility>
 
 namespace top_stocks
@@ -11,8 +12,85 @@ using TBase = double;
 using TChange = double;
 
 using TQuote = std::pair<TId, TChange>;
+
+// The default top size and the default capacity of its candidate set.
 const constexpr size_t TopSize = 10;
-using TTopList = std::array<TQuote, TopSize>;
+const constexpr size_t TopMaxCapacity = 16;
+
+template <size_t K>
+using TBasicTopList = std::array<TQuote, K>;
+using TTopList = TBasicTopList<TopSize>;
+
+struct Quote
+{
+    TId StockId;
+    double Price;
+};
+
+// Non-owning view of a contiguous sequence.
+template <typename T>
+struct Span
+{
+    Span() = default;
+
+    Span(T* aData, size_t aSize)
+        : mData(aData)
+        , mSize(aSize)
+    {
+
+    }
+
+    template <typename TContainer, typename = decltype(std::declval<TContainer&>().data())>
+    Span(TContainer& aContainer)
+        : mData(aContainer.data())
+        , mSize(aContainer.size())
+    {
+
+    }
+
+    template <size_t N>
+    Span(T (&aArray)[N])
+        : mData(aArray)
+        , mSize(N)
+    {
+
+    }
+
+    T* begin() const
+    {
+        return mData;
+    }
+
+    T* end() const
+    {
+        return mData + mSize;
+    }
+
+    T* data() const
+    {
+        return mData;
+    }
+
+    size_t size() const
+    {
+        return mSize;
+    }
+
+    bool empty() const
+    {
+        return !mSize;
+    }
+
+    T& operator[](size_t aIndex) const
+    {
+        return mData[aIndex];
+    }
+
+private:
+
+    T* mData = nullptr;
+    size_t mSize = 0;
+};
 
 struct ITopStocks
 {
@@ -20,15 +98,62 @@ struct ITopStocks
 
     virtual void OnQuote(int aStockId, double aPrice) = 0;
 
+    // Applies the quotes in order. Implementations may conflate the notifications raised within the batch.
+    virtual void OnQuotes(Span<const Quote> aQuotes)
+    {
+        for (const auto& quote : aQuotes)
+        {
+            OnQuote(quote.StockId, quote.Price);
+        }
+    }
+};
+
+enum class TopChangeKind
+{
+    // The stock is new to the list at Position.
+    Entered,
+    // The stock is no longer in the list, Position is the one it had.
+    Left,
+    // The stock moved from PreviousPosition to Position, its change may be updated as well.
+    Moved,
+    // The stock keeps its Position, its change is updated.
+    Updated,
+};
+
+// A difference between two consecutive notified lists. Positions are zero based.
+struct TopChange
+{
+    TopChangeKind Kind;
+    TId StockId;
+    size_t Position;
+    size_t PreviousPosition;
+    TChange Change;
 };
 
-struct ITopStocksHandler
+template <size_t K>
+struct IBasicTopStocksHandler
 {
-    virtual ~ITopStocksHandler() = default;
+    using TTopList = TBasicTopList<K>;
+
+    virtual ~IBasicTopStocksHandler() = default;
 
     virtual void ProcessTopGainersChanged(const TTopList&) = 0;
 
     virtual void ProcessTopLosersChanged(const TTopList&) = 0;
+
+    // Called instead of the full list callbacks once the deltas are enabled on the engine. The changes turn
+    // the previously notified list into the given one: the left stocks first, then the rest by position.
+    virtual void ProcessTopGainersDelta(const TTopList& aTop, Span<const TopChange>)
+    {
+        ProcessTopGainersChanged(aTop);
+    }
+
+    virtual void ProcessTopLosersDelta(const TTopList& aTop, Span<const TopChange>)
+    {
+        ProcessTopLosersChanged(aTop);
+    }
 };
 
+using ITopStocksHandler = IBasicTopStocksHandler<TopSize>;
+
 }
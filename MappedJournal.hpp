@@ -0,0 +1,122 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define TOP_STOCKS_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "TickJournal.hpp"
+
+namespace top_stocks
+{
+
+// Read-only view of a tick journal written by TickJournal. The file is memory-mapped with sequential
+// read-ahead advice and the records are read in place; where mmap is not available the file is read
+// into memory. A trailing partial record, e.g. of a crashed recorder, is ignored.
+struct MappedJournal
+{
+    explicit MappedJournal(const std::string& aPath)
+    {
+#ifdef TOP_STOCKS_MMAP
+        int file = ::open(aPath.c_str(), O_RDONLY);
+        if (file < 0)
+        {
+            throw std::runtime_error("Cannot open the journal " + aPath);
+        }
+
+        struct stat status {};
+        ::fstat(file, &status);
+        mSize = static_cast<size_t>(status.st_size);
+        if (mSize)
+        {
+            void* data = ::mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, file, 0);
+            if (data == MAP_FAILED)
+            {
+                ::close(file);
+                throw std::runtime_error("Cannot map the journal " + aPath);
+            }
+            ::madvise(data, mSize, MADV_SEQUENTIAL);
+            mData = static_cast<const char*>(data);
+        }
+        ::close(file);
+#else
+        std::FILE* file = std::fopen(aPath.c_str(), "rb");
+        if (!file)
+        {
+            throw std::runtime_error("Cannot open the journal " + aPath);
+        }
+        char chunk[1 << 16];
+        size_t size = 0;
+        while ((size = std::fread(chunk, 1, sizeof(chunk), file)) != 0)
+        {
+            mBuffer.insert(mBuffer.end(), chunk, chunk + size);
+        }
+        std::fclose(file);
+        mData = mBuffer.data();
+        mSize = mBuffer.size();
+#endif
+
+        if (!IsValid())
+        {
+            Unmap();
+            throw std::runtime_error("Not a tick journal " + aPath);
+        }
+    }
+
+    ~MappedJournal()
+    {
+        Unmap();
+    }
+
+    MappedJournal(const MappedJournal&) = delete;
+    MappedJournal& operator=(const MappedJournal&) = delete;
+
+    Span<const JournalRecord> Records() const
+    {
+        return {reinterpret_cast<const JournalRecord*>(mData + sizeof(JournalHeader)),
+            (mSize - sizeof(JournalHeader)) / sizeof(JournalRecord)};
+    }
+
+private:
+
+    bool IsValid() const
+    {
+        if (mSize < sizeof(JournalHeader))
+        {
+            return false;
+        }
+
+        const auto* header = reinterpret_cast<const JournalHeader*>(mData);
+        return std::equal(header->Magic, header->Magic + sizeof(header->Magic), JournalHeader::Signature)
+            && header->Version == JournalHeader::CurrentVersion
+            && header->RecordSize == sizeof(JournalRecord);
+    }
+
+    void Unmap()
+    {
+#ifdef TOP_STOCKS_MMAP
+        if (mData)
+        {
+            ::munmap(const_cast<char*>(mData), mSize);
+            mData = nullptr;
+        }
+#endif
+    }
+
+    const char* mData = nullptr;
+    size_t mSize = 0;
+#ifndef TOP_STOCKS_MMAP
+    std::vector<char> mBuffer;
+#endif
+};
+
+}
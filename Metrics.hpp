@@ -0,0 +1,129 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "Clock.hpp"
+
+namespace top_stocks
+{
+
+// A counter with a single writer. Incrementing is a relaxed load and store, so it costs about as much as
+// a plain increment; readers on other threads see a recent value.
+struct Counter
+{
+    void Increment(std::uint64_t aValue = 1)
+    {
+        mValue.store(mValue.load(std::memory_order_relaxed) + aValue, std::memory_order_relaxed);
+    }
+
+    void Store(std::uint64_t aValue)
+    {
+        mValue.store(aValue, std::memory_order_relaxed);
+    }
+
+    std::uint64_t Load() const
+    {
+        return mValue.load(std::memory_order_relaxed);
+    }
+
+private:
+
+    std::atomic<std::uint64_t> mValue {};
+};
+
+struct LatencySnapshot
+{
+    static const constexpr size_t Buckets = 40;
+
+    // Bucket i counts the latencies of [2^i, 2^(i+1)) ns, the first one counts shorter ones too.
+    std::array<std::uint64_t, Buckets> Counts {};
+    std::uint64_t Count = 0;
+    TDuration Total {};
+    TDuration Max {};
+
+    // The upper bound of the bucket holding the given fraction of the latencies, e.g. 0.99.
+    TDuration Percentile(double aFraction) const
+    {
+        std::uint64_t rank = static_cast<std::uint64_t>(aFraction * Count);
+        std::uint64_t count = 0;
+        for (size_t i = 0; i < Buckets; ++i)
+        {
+            count += Counts[i];
+            if (count > rank)
+            {
+                return std::min(TDuration(std::int64_t(2) << i), Max);
+            }
+        }
+        return Max;
+    }
+};
+
+// Log2 histogram of latencies with a single writer, see Counter.
+struct LatencyHistogram
+{
+    void Record(TDuration aLatency)
+    {
+        auto ns = static_cast<std::uint64_t>(std::max<TDuration::rep>(aLatency.count(), 0));
+
+        size_t bucket = 0;
+        while (bucket + 1 < LatencySnapshot::Buckets && ns >> (bucket + 1))
+        {
+            ++bucket;
+        }
+
+        mCounts[bucket].Increment();
+        mTotal.Increment(ns);
+        if (ns > mMax.Load())
+        {
+            mMax.Store(ns);
+        }
+    }
+
+    LatencySnapshot Snapshot() const
+    {
+        LatencySnapshot snapshot;
+        for (size_t i = 0; i < LatencySnapshot::Buckets; ++i)
+        {
+            snapshot.Counts[i] = mCounts[i].Load();
+            snapshot.Count += snapshot.Counts[i];
+        }
+        snapshot.Total = TDuration(mTotal.Load());
+        snapshot.Max = TDuration(mMax.Load());
+        return snapshot;
+    }
+
+private:
+
+    std::array<Counter, LatencySnapshot::Buckets> mCounts;
+    Counter mTotal;
+    Counter mMax;
+};
+
+struct TopSideMetrics
+{
+    std::uint64_t Restores;
+    std::uint64_t Notifications;
+    // Notifications of a list equal to the previously notified one.
+    std::uint64_t SpuriousNotifications;
+    // Lists equal to the previously notified one which were not notified, see EnableSuppression.
+    std::uint64_t SuppressedNotifications;
+    LatencySnapshot CallbackLatency;
+};
+
+struct TopStocksMetrics
+{
+    std::uint64_t Ticks;
+    // Ticks of an incorrect id, or of an incorrect price of a new stock.
+    std::uint64_t IgnoredTicks;
+    TopSideMetrics Gainers;
+    TopSideMetrics Losers;
+    // Per OnQuote call and per OnQuotes batch, the callbacks included.
+    LatencySnapshot QuoteLatency;
+    LatencySnapshot BatchLatency;
+};
+
+}
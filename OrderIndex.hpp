@@ -0,0 +1,242 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "ITopStocks.hpp"
+
+namespace top_stocks
+{
+
+// Keeps all the stocks ordered by (change, id) in an array-backed treap with subtree sizes.
+// Nodes are addressed by quote store slots, so updating a stock does not allocate.
+// Expected cost of an update is O(log N), the k best elements in either direction cost O(log N + k), and so
+// do the k elements from any position. The position of a stock costs O(log N).
+struct OrderIndex
+{
+    using TNode = std::uint32_t;
+    using TElement = std::pair<TChange, TId>;
+
+    static const constexpr TNode NoNode = std::numeric_limits<TNode>::max();
+
+    size_t Size() const
+    {
+        return mRoot == NoNode ? 0 : mSize[mRoot];
+    }
+
+    // The node must not be present. Nodes are expected to be inserted in the order of the store slots.
+    void Insert(TNode aNode, TChange aChange, TId aId)
+    {
+        if (mKeys.size() <= aNode)
+        {
+            Resize(aNode + 1);
+        }
+
+        mKeys[aNode] = {aChange, aId};
+        mLeft[aNode] = mRight[aNode] = NoNode;
+        mSize[aNode] = 1;
+
+        TNode left, right;
+        Split(mRoot, mKeys[aNode], left, right);
+        mRoot = Merge(Merge(left, aNode), right);
+    }
+
+    void Update(TNode aNode, TChange aChange)
+    {
+        if (mKeys[aNode].first != aChange)
+        {
+            mRoot = Erase(mRoot, mKeys[aNode]);
+            Insert(aNode, aChange, mKeys[aNode].second);
+        }
+    }
+
+    // Visits the stocks from the biggest change down (descending) or from the smallest one up until the
+    // visitor returns false.
+    template <typename TVisitor>
+    void Visit(bool aIsDescending, TVisitor aVisitor) const
+    {
+        Visit(aIsDescending, 0, aVisitor);
+    }
+
+    // Visits the stocks starting from the given 0-based position in the direction, skipping the ones before
+    // it in O(log N).
+    template <typename TVisitor>
+    void Visit(bool aIsDescending, size_t aFrom, TVisitor aVisitor) const
+    {
+        auto near = [this, aIsDescending](TNode aNode) { return aIsDescending ? mRight[aNode] : mLeft[aNode]; };
+        auto far = [this, aIsDescending](TNode aNode) { return aIsDescending ? mLeft[aNode] : mRight[aNode]; };
+
+        mStack.clear();
+        TNode node = mRoot;
+        while (node != NoNode)
+        {
+            size_t nearSize = SizeOf(near(node));
+            if (aFrom <= nearSize)
+            {
+                mStack.push_back(node);
+                node = aFrom < nearSize ? near(node) : NoNode;
+            }
+            else
+            {
+                aFrom -= nearSize + 1;
+                node = far(node);
+            }
+        }
+
+        while (node != NoNode || !mStack.empty())
+        {
+            while (node != NoNode)
+            {
+                mStack.push_back(node);
+                node = near(node);
+            }
+
+            node = mStack.back();
+            mStack.pop_back();
+            if (!aVisitor(mKeys[node]))
+            {
+                return;
+            }
+            node = far(node);
+        }
+    }
+
+    // The 0-based position of the present node in the direction.
+    size_t Rank(TNode aNode, bool aIsDescending) const
+    {
+        const auto& key = mKeys[aNode];
+
+        size_t less = 0;
+        TNode node = mRoot;
+        while (node != NoNode)
+        {
+            if (key < mKeys[node])
+            {
+                node = mLeft[node];
+            }
+            else if (mKeys[node] < key)
+            {
+                less += SizeOf(mLeft[node]) + 1;
+                node = mRight[node];
+            }
+            else
+            {
+                less += SizeOf(mLeft[node]);
+                break;
+            }
+        }
+        return aIsDescending ? Size() - 1 - less : less;
+    }
+
+private:
+
+    void Resize(size_t aSize)
+    {
+        size_t size = mKeys.size();
+        mKeys.resize(aSize);
+        mLeft.resize(aSize);
+        mRight.resize(aSize);
+        mSize.resize(aSize);
+        mPriority.resize(aSize);
+        for (; size < aSize; ++size)
+        {
+            // A fixed bijective mix of the node is as good as a random priority and keeps the shape reproducible.
+            std::uint32_t x = static_cast<std::uint32_t>(size) * 0x9E3779B9u;
+            x ^= x >> 16;
+            x *= 0x85EBCA6Bu;
+            x ^= x >> 13;
+            mPriority[size] = x;
+        }
+    }
+
+    size_t SizeOf(TNode aNode) const
+    {
+        return aNode == NoNode ? 0 : mSize[aNode];
+    }
+
+    void Refresh(TNode aNode)
+    {
+        mSize[aNode] = static_cast<std::uint32_t>(1 + SizeOf(mLeft[aNode]) + SizeOf(mRight[aNode]));
+    }
+
+    TNode Merge(TNode aLeft, TNode aRight)
+    {
+        if (aLeft == NoNode)
+        {
+            return aRight;
+        }
+        if (aRight == NoNode)
+        {
+            return aLeft;
+        }
+
+        if (mPriority[aLeft] > mPriority[aRight])
+        {
+            mRight[aLeft] = Merge(mRight[aLeft], aRight);
+            Refresh(aLeft);
+            return aLeft;
+        }
+
+        mLeft[aRight] = Merge(aLeft, mLeft[aRight]);
+        Refresh(aRight);
+        return aRight;
+    }
+
+    // Left gets the elements less than the key, right gets the rest.
+    void Split(TNode aNode, const TElement& aKey, TNode& aLeft, TNode& aRight)
+    {
+        if (aNode == NoNode)
+        {
+            aLeft = aRight = NoNode;
+            return;
+        }
+
+        if (mKeys[aNode] < aKey)
+        {
+            Split(mRight[aNode], aKey, mRight[aNode], aRight);
+            aLeft = aNode;
+        }
+        else
+        {
+            Split(mLeft[aNode], aKey, aLeft, mLeft[aNode]);
+            aRight = aNode;
+        }
+        Refresh(aNode);
+    }
+
+    TNode Erase(TNode aNode, const TElement& aKey)
+    {
+        assert(aNode != NoNode);
+
+        if (mKeys[aNode] == aKey)
+        {
+            return Merge(mLeft[aNode], mRight[aNode]);
+        }
+
+        if (aKey < mKeys[aNode])
+        {
+            mLeft[aNode] = Erase(mLeft[aNode], aKey);
+        }
+        else
+        {
+            mRight[aNode] = Erase(mRight[aNode], aKey);
+        }
+        --mSize[aNode];
+        return aNode;
+    }
+
+    TNode mRoot = NoNode;
+
+    std::vector<TElement> mKeys;
+    std::vector<TNode> mLeft;
+    std::vector<TNode> mRight;
+    std::vector<std::uint32_t> mSize;
+    std::vector<std::uint32_t> mPriority;
+
+    mutable std::vector<TNode> mStack;
+};
+
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "QuoteQueue.hpp"
+
+namespace top_stocks
+{
+
+// Decouples the feed thread from the quotes processing: quotes are pushed into a lock-free queue and
+// applied to the wrapped ITopStocks in batches by a dedicated engine thread. The handler of the wrapped
+// ITopStocks is called from the engine thread.
+struct QueuedTopStocks : ITopStocks
+{
+    static const constexpr size_t BatchSize = 256;
+
+    QueuedTopStocks(ITopStocks& aTopStocks, size_t aCapacity, Backpressure aBackpressure = Backpressure::Block,
+        TId aConflationLimit = QuoteQueue::DefaultConflationLimit)
+        : mTopStocks(aTopStocks)
+        , mQueue(aCapacity, aBackpressure, aConflationLimit)
+        , mThread(&QueuedTopStocks::Run, this)
+    {
+
+    }
+
+    ~QueuedTopStocks()
+    {
+        mIsStopped.store(true, std::memory_order_release);
+        Wake();
+        mThread.join();
+    }
+
+    void OnQuote(int aStockId, double aPrice) override
+    {
+        Push({aStockId, aPrice});
+    }
+
+    void OnQuotes(Span<const Quote> aQuotes) override
+    {
+        // Every quote may wake the engine thread, a blocking push would not return to a sleeping one.
+        for (const auto& quote : aQuotes)
+        {
+            Push(quote);
+        }
+    }
+
+    QuoteQueueStats Stats() const
+    {
+        return mQueue.Stats();
+    }
+
+    // Blocks until all the quotes pushed so far are processed. Must be called from the feed thread.
+    void Wait() const
+    {
+        while (true)
+        {
+            auto stats = mQueue.Stats();
+            if (mProcessed.load(std::memory_order_acquire) + stats.Dropped + stats.Conflated == stats.Pushed)
+            {
+                return;
+            }
+            std::this_thread::yield();
+        }
+    }
+
+private:
+
+    void Push(const Quote& aQuote)
+    {
+        mQueue.Push(aQuote);
+
+        // Pairs with the fence of the sleeping thread: either it sees the quote or this sees it sleeping.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (mIsSleeping.load(std::memory_order_relaxed))
+        {
+            Wake();
+        }
+    }
+
+    void Wake()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mIsSleeping.store(false, std::memory_order_relaxed);
+        }
+        mCondition.notify_one();
+    }
+
+    // Waits for a quote or the stop once spinning found the queue empty for a while.
+    void Sleep()
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mIsSleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!mQueue.Stats().Depth)
+        {
+            mCondition.wait(lock, [this]
+                {
+                    return !mIsSleeping.load(std::memory_order_relaxed)
+                        || mIsStopped.load(std::memory_order_acquire);
+                }
+            );
+        }
+        mIsSleeping.store(false, std::memory_order_relaxed);
+    }
+
+    void Run()
+    {
+        std::vector<Quote> batch(BatchSize);
+        size_t idleSpins = 0;
+        while (true)
+        {
+            size_t count = mQueue.Pop(batch.data(), batch.size());
+            if (count)
+            {
+                idleSpins = 0;
+                mTopStocks.OnQuotes({batch.data(), count});
+                mProcessed.fetch_add(count, std::memory_order_release);
+            }
+            else if (mIsStopped.load(std::memory_order_acquire))
+            {
+                return;
+            }
+            else if (++idleSpins > MaxIdleSpins)
+            {
+                idleSpins = 0;
+                Sleep();
+            }
+        }
+    }
+
+    static const constexpr size_t MaxIdleSpins = 1024;
+
+    ITopStocks& mTopStocks;
+    QuoteQueue mQueue;
+
+    std::atomic<std::uint64_t> mProcessed {};
+    std::atomic<bool> mIsSleeping {};
+    std::atomic<bool> mIsStopped {};
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+
+    std::thread mThread;
+};
+
+}
@@ -0,0 +1,190 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "ITopStocks.hpp"
+
+namespace top_stocks
+{
+
+enum class Backpressure
+{
+    // The producer waits for the consumer to free a slot.
+    Block,
+    // The oldest queued quote is dropped to free a slot.
+    DropOldest,
+    // A quote of a stock already queued only updates its price; blocks if there are too many stocks queued.
+    ConflatePerId,
+};
+
+struct QuoteQueueStats
+{
+    size_t Depth;
+    std::uint64_t Pushed;
+    std::uint64_t Dropped;
+    std::uint64_t Conflated;
+};
+
+// Bounded lock-free single-producer/single-consumer ring buffer of quotes.
+// The consumer commits reads by moving the head with a CAS, so the producer may drop the oldest quote
+// by moving the head itself. Slot fields are relaxed atomics: a torn read is never committed.
+struct QuoteQueue
+{
+    static const constexpr size_t CacheLineSize = 64;
+    static const constexpr TId DefaultConflationLimit = 1 << 16;
+
+    // The capacity is rounded up to a power of two. Conflation applies to ids below the conflation limit.
+    explicit QuoteQueue(size_t aCapacity, Backpressure aBackpressure = Backpressure::Block,
+        TId aConflationLimit = DefaultConflationLimit)
+        : mBackpressure(aBackpressure)
+        , mCapacity(RoundUp(aCapacity))
+        , mSlots(new Slot[mCapacity])
+    {
+        if (mBackpressure == Backpressure::ConflatePerId)
+        {
+            mConflation.reset(new ConflationSlot[aConflationLimit]);
+            mConflationLimit = aConflationLimit;
+        }
+    }
+
+    // Producer side.
+    void Push(const Quote& aQuote)
+    {
+        Increment(mPushed);
+
+        if (aQuote.StockId >= 0 && aQuote.StockId < mConflationLimit)
+        {
+            auto& conflation = mConflation[aQuote.StockId];
+            conflation.mPrice.store(aQuote.Price, std::memory_order_relaxed);
+            if (conflation.mIsQueued.exchange(true, std::memory_order_acq_rel))
+            {
+                Increment(mConflated);
+                return;
+            }
+        }
+
+        size_t tail = mTail.load(std::memory_order_relaxed);
+        while (tail - mCachedHead == mCapacity)
+        {
+            mCachedHead = mHead.load(std::memory_order_acquire);
+            if (tail - mCachedHead < mCapacity)
+            {
+                break;
+            }
+
+            if (mBackpressure == Backpressure::DropOldest)
+            {
+                if (mHead.compare_exchange_weak(mCachedHead, mCachedHead + 1, std::memory_order_acq_rel))
+                {
+                    ++mCachedHead;
+                    Increment(mDropped);
+                }
+            }
+            else
+            {
+                std::this_thread::yield();
+            }
+        }
+
+        auto& slot = mSlots[tail & (mCapacity - 1)];
+        slot.mId.store(aQuote.StockId, std::memory_order_relaxed);
+        slot.mPrice.store(aQuote.Price, std::memory_order_relaxed);
+        mTail.store(tail + 1, std::memory_order_release);
+    }
+
+    // Consumer side. Returns the number of quotes popped into the buffer.
+    size_t Pop(Quote* aBuffer, size_t aSize)
+    {
+        size_t head = mHead.load(std::memory_order_acquire);
+        size_t count = 0;
+        do
+        {
+            size_t tail = mTail.load(std::memory_order_acquire);
+            count = std::min(tail - head, aSize);
+            for (size_t i = 0; i < count; ++i)
+            {
+                const auto& slot = mSlots[(head + i) & (mCapacity - 1)];
+                aBuffer[i] = {slot.mId.load(std::memory_order_relaxed), slot.mPrice.load(std::memory_order_relaxed)};
+            }
+        }
+        while (count && !mHead.compare_exchange_weak(head, head + count, std::memory_order_acq_rel));
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            auto& quote = aBuffer[i];
+            if (quote.StockId >= 0 && quote.StockId < mConflationLimit)
+            {
+                auto& conflation = mConflation[quote.StockId];
+                conflation.mIsQueued.exchange(false, std::memory_order_acq_rel);
+                quote.Price = conflation.mPrice.load(std::memory_order_relaxed);
+            }
+        }
+
+        return count;
+    }
+
+    QuoteQueueStats Stats() const
+    {
+        size_t tail = mTail.load(std::memory_order_acquire);
+        size_t head = mHead.load(std::memory_order_acquire);
+        return {
+            tail - std::min(head, tail),
+            mPushed.load(std::memory_order_relaxed),
+            mDropped.load(std::memory_order_relaxed),
+            mConflated.load(std::memory_order_relaxed),
+        };
+    }
+
+private:
+
+    struct Slot
+    {
+        std::atomic<TId> mId {};
+        std::atomic<double> mPrice {};
+    };
+
+    struct ConflationSlot
+    {
+        std::atomic<double> mPrice {};
+        std::atomic<bool> mIsQueued {};
+    };
+
+    static size_t RoundUp(size_t aCapacity)
+    {
+        size_t capacity = 1;
+        while (capacity < aCapacity)
+        {
+            capacity <<= 1;
+        }
+        return capacity;
+    }
+
+    // Counters have a single writer, the producer.
+    static void Increment(std::atomic<std::uint64_t>& aCounter)
+    {
+        aCounter.store(aCounter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    const Backpressure mBackpressure;
+    const size_t mCapacity;
+    std::unique_ptr<Slot[]> mSlots;
+
+    std::unique_ptr<ConflationSlot[]> mConflation;
+    TId mConflationLimit = 0;
+
+    alignas(CacheLineSize) std::atomic<size_t> mHead {};
+
+    alignas(CacheLineSize) std::atomic<size_t> mTail {};
+    size_t mCachedHead = 0;
+    std::atomic<std::uint64_t> mPushed {};
+    std::atomic<std::uint64_t> mDropped {};
+    std::atomic<std::uint64_t> mConflated {};
+};
+
+}
@@ -0,0 +1,199 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "ITopStocks.hpp"
+
+namespace top_stocks
+{
+
+// Keeps base prices and percent changes of all the stocks in contiguous columns (struct of arrays).
+// A stock gets a slot when it is first seen; slots are never freed, so the columns stay dense.
+// Ids below the dense limit are resolved through a flat id-indexed table, the rest through a compact
+// open-addressing table. Ids must be positive.
+struct QuoteStore
+{
+    using TSlot = std::uint32_t;
+
+    static const constexpr TSlot NoSlot = std::numeric_limits<TSlot>::max();
+    static const constexpr TId DefaultDenseLimit = 1 << 20;
+
+    explicit QuoteStore(TId aDenseLimit = DefaultDenseLimit)
+        : mDenseLimit(aDenseLimit)
+    {
+
+    }
+
+    TSlot Find(TId aId) const
+    {
+        assert(aId > 0);
+
+        if (aId < mDenseLimit)
+        {
+            return static_cast<size_t>(aId) < mDenseIndex.size() ? mDenseIndex[aId] : NoSlot;
+        }
+
+        if (mSparseIndex.empty())
+        {
+            return NoSlot;
+        }
+
+        for (size_t i = Hash(aId);; i = (i + 1) & (mSparseIndex.size() - 1))
+        {
+            const auto& entry = mSparseIndex[i];
+            if (entry.first == aId)
+            {
+                return entry.second;
+            }
+            if (entry.first == EmptyId)
+            {
+                return NoSlot;
+            }
+        }
+    }
+
+    // The id must not be present.
+    TSlot Insert(TId aId, TBase aBase, TChange aChange)
+    {
+        assert(Find(aId) == NoSlot);
+
+        TSlot slot = static_cast<TSlot>(mIds.size());
+        mIds.push_back(aId);
+        mBases.push_back(aBase);
+        mChanges.push_back(aChange);
+
+        if (aId < mDenseLimit)
+        {
+            if (mDenseIndex.size() <= static_cast<size_t>(aId))
+            {
+                mDenseIndex.resize(static_cast<size_t>(aId) + 1, NoSlot);
+            }
+            mDenseIndex[aId] = slot;
+        }
+        else
+        {
+            if ((mSparseSize + 1) * 2 > mSparseIndex.size())
+            {
+                Rehash(mSparseIndex.empty() ? MinSparseCapacity : mSparseIndex.size() * 2);
+            }
+            Place(aId, slot);
+            ++mSparseSize;
+        }
+
+        return slot;
+    }
+
+    size_t Size() const
+    {
+        return mIds.size();
+    }
+
+    void Reserve(size_t aSize)
+    {
+        mIds.reserve(aSize);
+        mBases.reserve(aSize);
+        mChanges.reserve(aSize);
+    }
+
+    void Clear()
+    {
+        mDenseIndex.clear();
+        mSparseIndex.clear();
+        mSparseSize = 0;
+        mIds.clear();
+        mBases.clear();
+        mChanges.clear();
+    }
+
+    TId Id(TSlot aSlot) const
+    {
+        return mIds[aSlot];
+    }
+
+    TBase& Base(TSlot aSlot)
+    {
+        return mBases[aSlot];
+    }
+
+    TBase Base(TSlot aSlot) const
+    {
+        return mBases[aSlot];
+    }
+
+    TChange& Change(TSlot aSlot)
+    {
+        return mChanges[aSlot];
+    }
+
+    TChange Change(TSlot aSlot) const
+    {
+        return mChanges[aSlot];
+    }
+
+    const TId* Ids() const
+    {
+        return mIds.data();
+    }
+
+    const TBase* Bases() const
+    {
+        return mBases.data();
+    }
+
+    const TChange* Changes() const
+    {
+        return mChanges.data();
+    }
+
+private:
+
+    using TSparseEntry = std::pair<TId, TSlot>;
+
+    size_t Hash(TId aId) const
+    {
+        // Fibonacci hashing, the table size is a power of two.
+        return static_cast<size_t>((static_cast<std::uint64_t>(aId) * 0x9E3779B97F4A7C15ull) >> 32)
+            & (mSparseIndex.size() - 1);
+    }
+
+    void Place(TId aId, TSlot aSlot)
+    {
+        size_t i = Hash(aId);
+        while (mSparseIndex[i].first != EmptyId)
+        {
+            i = (i + 1) & (mSparseIndex.size() - 1);
+        }
+        mSparseIndex[i] = {aId, aSlot};
+    }
+
+    void Rehash(size_t aCapacity)
+    {
+        std::vector<TSparseEntry> old(aCapacity, TSparseEntry{EmptyId, NoSlot});
+        old.swap(mSparseIndex);
+        for (const auto& e : old)
+        {
+            if (e.first != EmptyId)
+            {
+                Place(e.first, e.second);
+            }
+        }
+    }
+
+    static const constexpr TId EmptyId = 0;
+    static const constexpr size_t MinSparseCapacity = 16;
+
+    TId mDenseLimit;
+
+    std::vector<TSlot> mDenseIndex;
+    std::vector<TSparseEntry> mSparseIndex;
+    size_t mSparseSize = 0;
+
+    std::vector<TId> mIds;
+    std::vector<TBase> mBases;
+    std::vector<TChange> mChanges;
+};
+
+}
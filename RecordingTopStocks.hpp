@@ -0,0 +1,60 @@
+#pragma once
+
+#include <string>
+
+#include "Clock.hpp"
+#include "TickJournal.hpp"
+
+namespace top_stocks
+{
+
+// Records every quote into a tick journal with the time of its arrival and passes it on to the wrapped
+// ITopStocks. Recording costs a clock read and a copy into the journal buffer, the file is written by
+// the journal thread.
+struct RecordingTopStocks : ITopStocks
+{
+    RecordingTopStocks(ITopStocks& aTopStocks, const std::string& aPath,
+        size_t aBufferRecords = TickJournal::DefaultBufferRecords, const IClock& aClock = SteadyClock::Instance())
+        : mTopStocks(aTopStocks)
+        , mJournal(aPath, aBufferRecords)
+        , mClock(aClock)
+    {
+
+    }
+
+    void OnQuote(int aStockId, double aPrice) override
+    {
+        mJournal.Append(mClock.Now().time_since_epoch().count(), aStockId, aPrice);
+        mTopStocks.OnQuote(aStockId, aPrice);
+    }
+
+    // The quotes of a batch share the timestamp.
+    void OnQuotes(Span<const Quote> aQuotes) override
+    {
+        auto timestamp = mClock.Now().time_since_epoch().count();
+        for (const auto& quote : aQuotes)
+        {
+            mJournal.Append(timestamp, quote.StockId, quote.Price);
+        }
+        mTopStocks.OnQuotes(aQuotes);
+    }
+
+    // Hands the recorded ticks to the journal thread, e.g. periodically or before an expected shutdown.
+    void Flush()
+    {
+        mJournal.Flush();
+    }
+
+    TickJournalStats Stats() const
+    {
+        return mJournal.Stats();
+    }
+
+private:
+
+    ITopStocks& mTopStocks;
+    TickJournal mJournal;
+    const IClock& mClock;
+};
+
+}
@@ -0,0 +1,118 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "../MappedJournal.hpp"
+#include "../TopStocks.hpp"
+#include "TopListLog.hpp"
+
+namespace
+{
+
+void PrintUsage()
+{
+    std::cerr << "Usage: Replay <journal> [--speed max|<factor>] [--record <log>] [--expect <log>]" << std::endl
+        << "  --speed   max replays as fast as possible (default), 1 at the recorded pace, 2 twice as fast" << std::endl
+        << "  --record  writes the notified lists to the log" << std::endl
+        << "  --expect  compares the notified lists with a log recorded before, exits with 1 on a mismatch"
+        << std::endl;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    using namespace top_stocks;
+
+    if (argc < 2)
+    {
+        PrintUsage();
+        return 2;
+    }
+
+    std::string journalPath = argv[1];
+    double speed = 0;
+    replay::TopListLog log;
+
+    try
+    {
+        for (int i = 2; i < argc; i += 2)
+        {
+            if (i + 1 == argc)
+            {
+                // An option without its value.
+                PrintUsage();
+                return 2;
+            }
+
+            if (!std::strcmp(argv[i], "--speed"))
+            {
+                if (std::strcmp(argv[i + 1], "max"))
+                {
+                    char* end = nullptr;
+                    speed = std::strtod(argv[i + 1], &end);
+                    if (*end || !(speed > 0))
+                    {
+                        PrintUsage();
+                        return 2;
+                    }
+                }
+            }
+            else if (!std::strcmp(argv[i], "--record"))
+            {
+                log.Record(argv[i + 1]);
+            }
+            else if (!std::strcmp(argv[i], "--expect"))
+            {
+                log.Expect(argv[i + 1]);
+            }
+            else
+            {
+                PrintUsage();
+                return 2;
+            }
+        }
+
+        MappedJournal journal(journalPath);
+        auto records = journal.Records();
+
+        TopStocks topStocks(log);
+
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < records.size(); ++i)
+        {
+            const auto& record = records[i];
+            if (speed > 0)
+            {
+                // Ticks are replayed at the recorded offsets from the first one divided by the speed.
+                std::chrono::nanoseconds offset(
+                    static_cast<std::int64_t>((record.Timestamp - records[0].Timestamp) / speed));
+                std::this_thread::sleep_until(start + offset);
+            }
+
+            log.SetTick(i);
+            topStocks.OnQuote(record.StockId, record.Price);
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        auto mismatches = log.Finish();
+        std::cout << "{\"ticks\": " << records.size()
+            << ", \"seconds\": " << elapsed.count()
+            << ", \"ticks_per_sec\": " << static_cast<std::uint64_t>(records.size() / elapsed.count())
+            << ", \"notifications\": " << log.Notifications()
+            << ", \"mismatches\": " << mismatches
+            << "}" << std::endl;
+
+        return mismatches ? 1 : 0;
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 2;
+    }
+}
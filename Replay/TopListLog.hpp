@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "../ITopStocks.hpp"
+
+namespace top_stocks
+{
+
+namespace replay
+{
+
+// Writes the notified lists as text, one line per notification: the side (G or L) followed by the
+// id and change pairs, changes printed exactly. Optionally compares every line against a log recorded
+// before and counts the differences.
+struct TopListLog : ITopStocksHandler
+{
+    void Record(const std::string& aPath)
+    {
+        mOutput.open(aPath);
+        if (!mOutput)
+        {
+            throw std::runtime_error("Cannot create " + aPath);
+        }
+    }
+
+    void Expect(const std::string& aPath)
+    {
+        mExpected.open(aPath);
+        if (!mExpected)
+        {
+            throw std::runtime_error("Cannot open " + aPath);
+        }
+    }
+
+    // The tick being replayed, for the mismatch reports.
+    void SetTick(std::uint64_t aTick)
+    {
+        mTick = aTick;
+    }
+
+    void ProcessTopGainersChanged(const TTopList& aTop) override
+    {
+        Log('G', aTop);
+    }
+
+    void ProcessTopLosersChanged(const TTopList& aTop) override
+    {
+        Log('L', aTop);
+    }
+
+    // Expected lines which were not notified are mismatches too.
+    std::uint64_t Finish()
+    {
+        std::string line;
+        while (mExpected.is_open() && std::getline(mExpected, line))
+        {
+            Report("<none>", line);
+        }
+        return mMismatches;
+    }
+
+    std::uint64_t Notifications() const
+    {
+        return mNotifications;
+    }
+
+private:
+
+    void Log(char aSide, const TTopList& aTop)
+    {
+        ++mNotifications;
+
+        mLine.assign(1, aSide);
+        char pair[64];
+        for (const auto& e : aTop)
+        {
+            std::snprintf(pair, sizeof(pair), " %d %.17g", e.first, e.second);
+            mLine += pair;
+        }
+
+        if (mOutput.is_open())
+        {
+            mOutput << mLine << '\n';
+        }
+
+        if (mExpected.is_open())
+        {
+            std::string expected;
+            if (!std::getline(mExpected, expected))
+            {
+                expected = "<none>";
+            }
+            if (expected != mLine)
+            {
+                Report(mLine, expected);
+            }
+        }
+    }
+
+    void Report(const std::string& aActual, const std::string& aExpected)
+    {
+        if (!mMismatches++)
+        {
+            std::cerr << "First mismatch at tick " << mTick << ", notification " << mNotifications << std::endl
+                << "Expected: " << aExpected << std::endl
+                << "Actual:   " << aActual << std::endl;
+        }
+    }
+
+    std::ofstream mOutput;
+    std::ifstream mExpected;
+    std::string mLine;
+
+    std::uint64_t mTick = 0;
+    std::uint64_t mNotifications = 0;
+    std::uint64_t mMismatches = 0;
+};
+
+}
+}
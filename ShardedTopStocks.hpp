@@ -0,0 +1,319 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "QuoteQueue.hpp"
+#include "TopStocks.hpp"
+
+namespace top_stocks
+{
+
+// Splits the stocks by id across worker threads, each of them runs its own TopStocks over its slice.
+// Every shard gets its quotes through its own lock-free queue, its thread sleeps only when the queue is empty
+// and is woken by the first quote after that. A shard ranks its stocks by local ids, i.e. the ids divided by
+// the number of shards, so its dense ids take a shard's part of the dense id limit.
+// Whenever a shard top changes the shard tops are merged into the global one, the handler is notified
+// only if the global top has changed. The handler is called from the worker threads, one call at a time.
+struct ShardedTopStocks : ITopStocks
+{
+    static const constexpr size_t QueueCapacity = 1 << 14;
+
+    ShardedTopStocks(ITopStocksHandler& aHandler, size_t aShards = std::thread::hardware_concurrency(),
+        TId aDenseIdLimit = QuoteStore::DefaultDenseLimit)
+        : mHander(aHandler)
+        , mGainers(std::max<size_t>(aShards, 1))
+        , mLosers(std::max<size_t>(aShards, 1))
+    {
+        auto shards = mGainers.mShardTops.size();
+        for (size_t i = 0; i < shards; ++i)
+        {
+            mShards.emplace_back(new Shard(*this, i, aDenseIdLimit / static_cast<TId>(shards) + 1));
+        }
+    }
+
+    ~ShardedTopStocks()
+    {
+        for (auto& shard : mShards)
+        {
+            shard->Stop();
+        }
+    }
+
+    void OnQuote(int aStockId, double aPrice) override
+    {
+        if (aStockId > 0)
+        {
+            Push({aStockId, aPrice});
+        }
+    }
+
+    void OnQuotes(Span<const Quote> aQuotes) override
+    {
+        for (const auto& quote : aQuotes)
+        {
+            if (quote.StockId > 0)
+            {
+                Push(quote);
+            }
+        }
+    }
+
+    // Blocks until all the quotes pushed so far are processed and notified. Must be called from the feed thread.
+    void Wait()
+    {
+        for (auto& shard : mShards)
+        {
+            shard->Wait();
+        }
+    }
+
+private:
+
+    struct Shard : ITopStocksHandler
+    {
+        static const constexpr size_t BatchSize = 256;
+
+        Shard(ShardedTopStocks& aOwner, size_t aIndex, TId aDenseIdLimit)
+            : mOwner(aOwner)
+            , mIndex(aIndex)
+            , mTopStocks(*this, aDenseIdLimit)
+            , mQueue(QueueCapacity)
+            , mThread(&Shard::Run, this)
+        {
+
+        }
+
+        // Producer side, the quote has a local id.
+        void Push(const Quote& aQuote)
+        {
+            mQueue.Push(aQuote);
+
+            // Pairs with the fence of the sleeping thread: either it sees the quote or this sees it sleeping.
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (mIsSleeping.load(std::memory_order_relaxed))
+            {
+                Wake();
+            }
+        }
+
+        void Wait() const
+        {
+            while (mProcessed.load(std::memory_order_acquire) != mQueue.Stats().Pushed)
+            {
+                std::this_thread::yield();
+            }
+        }
+
+        void Stop()
+        {
+            mIsStopped.store(true, std::memory_order_release);
+            Wake();
+            mThread.join();
+        }
+
+        void ProcessTopGainersChanged(const TTopList& aTop) override
+        {
+            mOwner.Merge(mOwner.mGainers, mIndex, aTop, std::greater<TTopElement>(),
+                &ITopStocksHandler::ProcessTopGainersChanged);
+        }
+
+        void ProcessTopLosersChanged(const TTopList& aTop) override
+        {
+            mOwner.Merge(mOwner.mLosers, mIndex, aTop, std::less<TTopElement>(),
+                &ITopStocksHandler::ProcessTopLosersChanged);
+        }
+
+    private:
+
+        static const constexpr size_t MaxIdleSpins = 1024;
+
+        void Wake()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                mIsSleeping.store(false, std::memory_order_relaxed);
+            }
+            mCondition.notify_one();
+        }
+
+        void Sleep()
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mIsSleeping.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!mQueue.Stats().Depth)
+            {
+                mCondition.wait(lock, [this]
+                    {
+                        return !mIsSleeping.load(std::memory_order_relaxed)
+                            || mIsStopped.load(std::memory_order_acquire);
+                    }
+                );
+            }
+            mIsSleeping.store(false, std::memory_order_relaxed);
+        }
+
+        void Run()
+        {
+            std::vector<Quote> batch(BatchSize);
+            size_t idleSpins = 0;
+            while (true)
+            {
+                size_t count = mQueue.Pop(batch.data(), batch.size());
+                if (count)
+                {
+                    idleSpins = 0;
+                    mTopStocks.OnQuotes({batch.data(), count});
+                    mProcessed.fetch_add(count, std::memory_order_release);
+                }
+                else if (mIsStopped.load(std::memory_order_acquire))
+                {
+                    return;
+                }
+                else if (++idleSpins > MaxIdleSpins)
+                {
+                    idleSpins = 0;
+                    Sleep();
+                }
+            }
+        }
+
+        ShardedTopStocks& mOwner;
+        size_t mIndex;
+
+        TopStocks mTopStocks;
+        QuoteQueue mQueue;
+
+        std::atomic<std::uint64_t> mProcessed {};
+        std::atomic<bool> mIsSleeping {};
+        std::atomic<bool> mIsStopped {};
+        std::mutex mMutex;
+        std::condition_variable mCondition;
+
+        std::thread mThread;
+    };
+
+    using TTopElement = std::pair<TChange, TId>;
+
+    struct MergedTop
+    {
+        explicit MergedTop(size_t aShards)
+            : mShardTops(aShards, TTopList{})
+        {
+
+        }
+
+        std::vector<TTopList> mShardTops;
+        TTopList mTop {};
+        // Versions of the merged top, the notified one is guarded by the notify mutex.
+        std::uint64_t mVersion = 0;
+        std::uint64_t mNotifiedVersion = 0;
+    };
+
+    size_t ShardOf(TId aStockId) const
+    {
+        return static_cast<size_t>(aStockId) % mShards.size();
+    }
+
+    // Local ids are positive as well.
+    TId LocalId(TId aStockId) const
+    {
+        return aStockId / static_cast<TId>(mShards.size()) + 1;
+    }
+
+    TId GlobalId(size_t aShard, TId aLocalId) const
+    {
+        return (aLocalId - 1) * static_cast<TId>(mShards.size()) + static_cast<TId>(aShard);
+    }
+
+    void Push(const Quote& aQuote)
+    {
+        mShards[ShardOf(aQuote.StockId)]->Push({LocalId(aQuote.StockId), aQuote.Price});
+    }
+
+    // The handler is called after the merge mutex is released, so that the other shards keep merging meanwhile.
+    // A merged top overtaken by a newer one before being notified is skipped.
+    template <typename TComparator>
+    void Merge(MergedTop& aMerged, size_t aShard, const TTopList& aTop, TComparator aComparator,
+        void (ITopStocksHandler::*aNotify)(const TTopList&))
+    {
+        TTopList top {};
+        std::uint64_t version = 0;
+        {
+            std::lock_guard<std::mutex> lock(mMergeMutex);
+            if (!MergeLocked(aMerged, aShard, aTop, aComparator, top))
+            {
+                return;
+            }
+            version = ++aMerged.mVersion;
+        }
+
+        std::lock_guard<std::mutex> lock(mNotifyMutex);
+        if (version > aMerged.mNotifiedVersion)
+        {
+            aMerged.mNotifiedVersion = version;
+            (mHander.*aNotify)(top);
+        }
+    }
+
+    // Returns whether the merged top has changed, along with the new one.
+    template <typename TComparator>
+    bool MergeLocked(MergedTop& aMerged, size_t aShard, const TTopList& aTop, TComparator aComparator,
+        TTopList& aNewTop)
+    {
+        aMerged.mShardTops[aShard] = aTop;
+
+        // Empty positions of a shard having less than TopSize stocks hold zero ids.
+        mCandidates.clear();
+        size_t shard = 0;
+        for (const auto& top : aMerged.mShardTops)
+        {
+            for (const auto& e : top)
+            {
+                if (e.first)
+                {
+                    mCandidates.emplace_back(e.second, GlobalId(shard, e.first));
+                }
+            }
+            ++shard;
+        }
+
+        auto last = mCandidates.begin() + std::min(TopSize, mCandidates.size());
+        std::partial_sort(mCandidates.begin(), last, mCandidates.end(), aComparator);
+
+        std::transform(mCandidates.begin(), last, aNewTop.begin(),
+            [](const auto& e)
+            {
+                return TQuote{e.second, e.first};
+            }
+        );
+
+        if (aNewTop == aMerged.mTop)
+        {
+            return false;
+        }
+
+        aMerged.mTop = aNewTop;
+        return true;
+    }
+
+    ITopStocksHandler& mHander;
+
+    std::mutex mMergeMutex;
+    std::mutex mNotifyMutex;
+    MergedTop mGainers;
+    MergedTop mLosers;
+    std::vector<TTopElement> mCandidates;
+
+    std::vector<std::unique_ptr<Shard>> mShards;
+};
+
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+
+namespace top_stocks
+{
+
+// A snapshot file is the header followed by the id, base and change columns of the stocks and by the
+// states of the gainers and losers candidate sets.
+struct SnapshotHeader
+{
+    static const constexpr char Signature[8] = {'T', 'O', 'P', 'S', 'N', 'A', 'P', 'S'};
+    static const constexpr std::uint32_t CurrentVersion = 2;
+
+    char Magic[8];
+    std::uint32_t Version;
+    // The top size and the candidate set capacity of the engine, a snapshot loads into the same ones.
+    std::uint32_t TopSize;
+    std::uint32_t Capacity;
+    // The change units per percent of the engine's change model.
+    std::uint32_t ChangeUnits;
+    std::uint64_t Stocks;
+};
+
+static_assert(sizeof(SnapshotHeader) == 32, "The snapshot layout is fixed");
+
+namespace details
+{
+
+template <typename T>
+bool Write(std::FILE* aFile, const T* aData, size_t aCount)
+{
+    return !aCount || std::fwrite(aData, sizeof(T), aCount, aFile) == aCount;
+}
+
+template <typename T>
+bool Read(std::FILE* aFile, T* aData, size_t aCount)
+{
+    return !aCount || std::fread(aData, sizeof(T), aCount, aFile) == aCount;
+}
+
+// The bytes from the current position to the end of the file, false if the file cannot be seeked.
+inline bool RemainingSize(std::FILE* aFile, std::uint64_t& aSize)
+{
+    long position = std::ftell(aFile);
+    if (position < 0 || std::fseek(aFile, 0, SEEK_END))
+    {
+        return false;
+    }
+
+    long end = std::ftell(aFile);
+    if (end < position || std::fseek(aFile, position, SEEK_SET))
+    {
+        return false;
+    }
+
+    aSize = static_cast<std::uint64_t>(end - position);
+    return true;
+}
+
+}
+
+}
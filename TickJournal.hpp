@@ -0,0 +1,216 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "ITopStocks.hpp"
+#include "Metrics.hpp"
+
+namespace top_stocks
+{
+
+// The journal file is the header followed by the records in the order of the ticks.
+struct JournalHeader
+{
+    static const constexpr char Signature[8] = {'T', 'O', 'P', 'T', 'I', 'C', 'K', 'S'};
+    static const constexpr std::uint32_t CurrentVersion = 1;
+
+    char Magic[8];
+    std::uint32_t Version;
+    std::uint32_t RecordSize;
+};
+
+struct JournalRecord
+{
+    // Nanoseconds of the recording clock.
+    std::int64_t Timestamp;
+    double Price;
+    TId StockId;
+    std::int32_t Reserved;
+};
+
+static_assert(sizeof(JournalHeader) == 16 && sizeof(JournalRecord) == 24, "The journal layout is fixed");
+
+struct TickJournalStats
+{
+    std::uint64_t Recorded;
+    // Ticks which did not fit while all the buffers were waiting to be written.
+    std::uint64_t Dropped;
+    std::uint64_t Written;
+    bool IsFailed;
+};
+
+// Appends fixed-size tick records to preallocated buffers. A full buffer is handed to a background thread
+// which writes it to the file in one sequential write while the feed thread fills the next one.
+// The feed thread never waits for I/O: if the writer falls behind by all the buffers the new ticks are
+// dropped and counted.
+struct TickJournal
+{
+    static const constexpr size_t DefaultBufferRecords = 1 << 16;
+    static const constexpr size_t Buffers = 4;
+
+    explicit TickJournal(const std::string& aPath, size_t aBufferRecords = DefaultBufferRecords)
+        : mBufferRecords(aBufferRecords)
+        , mFile(std::fopen(aPath.c_str(), "wb"))
+    {
+        if (!mFile)
+        {
+            throw std::runtime_error("Cannot open the journal " + aPath);
+        }
+        std::setvbuf(mFile, nullptr, _IONBF, 0);
+
+        JournalHeader header {};
+        std::copy(std::begin(JournalHeader::Signature), std::end(JournalHeader::Signature), header.Magic);
+        header.Version = JournalHeader::CurrentVersion;
+        header.RecordSize = sizeof(JournalRecord);
+        Write(&header, sizeof(header));
+
+        for (auto& buffer : mBuffers)
+        {
+            buffer.mRecords.reset(new JournalRecord[mBufferRecords]);
+        }
+
+        mThread = std::thread(&TickJournal::Run, this);
+    }
+
+    ~TickJournal()
+    {
+        Wait();
+        Flush();
+        mIsStopped.store(true, std::memory_order_release);
+        mCondition.notify_one();
+        mThread.join();
+        std::fclose(mFile);
+    }
+
+    // Feed thread.
+    void Append(std::int64_t aTimestamp, TId aStockId, double aPrice)
+    {
+        if (mSize == mBufferRecords && !HandOff())
+        {
+            mDropped.Increment();
+            return;
+        }
+
+        mBuffers[mFilled % Buffers].mRecords[mSize++] = {aTimestamp, aPrice, aStockId, 0};
+        mRecorded.Increment();
+    }
+
+    // Feed thread. Hands the partially filled buffer to the writer without waiting.
+    void Flush()
+    {
+        HandOff();
+    }
+
+    // Feed thread. Blocks until all the buffers handed off are written.
+    void Wait() const
+    {
+        while (mWritten.load(std::memory_order_acquire) != mFilled)
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    // May be called from any thread.
+    TickJournalStats Stats() const
+    {
+        return {mRecorded.Load(), mDropped.Load(), mWrittenRecords.Load(), mIsFailed.load(std::memory_order_relaxed)};
+    }
+
+private:
+
+    struct Buffer
+    {
+        std::unique_ptr<JournalRecord[]> mRecords;
+        size_t mSize = 0;
+    };
+
+    bool HandOff()
+    {
+        if (!mSize || mFilled + 1 - mWritten.load(std::memory_order_acquire) == Buffers)
+        {
+            return false;
+        }
+
+        mBuffers[mFilled % Buffers].mSize = mSize;
+        mSize = 0;
+        mFilledShared.store(++mFilled, std::memory_order_release);
+        mCondition.notify_one();
+        return true;
+    }
+
+    void Run()
+    {
+        std::uint64_t written = 0;
+        while (true)
+        {
+            std::uint64_t filled = mFilledShared.load(std::memory_order_acquire);
+            for (; written < filled; ++written)
+            {
+                const auto& buffer = mBuffers[written % Buffers];
+                Write(buffer.mRecords.get(), buffer.mSize * sizeof(JournalRecord));
+                mWrittenRecords.Increment(buffer.mSize);
+                mWritten.store(written + 1, std::memory_order_release);
+            }
+
+            if (mIsStopped.load(std::memory_order_acquire))
+            {
+                if (written == mFilledShared.load(std::memory_order_acquire))
+                {
+                    return;
+                }
+                continue;
+            }
+
+            // A hand-off notified between the check and the wait is picked up by the timeout.
+            std::unique_lock<std::mutex> lock(mMutex);
+            mCondition.wait_for(lock, std::chrono::milliseconds(10),
+                [this, written]
+                {
+                    return mFilledShared.load(std::memory_order_acquire) != written
+                        || mIsStopped.load(std::memory_order_acquire);
+                }
+            );
+        }
+    }
+
+    void Write(const void* aData, size_t aSize)
+    {
+        if (aSize && std::fwrite(aData, aSize, 1, mFile) != 1)
+        {
+            mIsFailed.store(true, std::memory_order_relaxed);
+        }
+    }
+
+    const size_t mBufferRecords;
+    std::FILE* mFile;
+    Buffer mBuffers[Buffers];
+
+    // Feed thread: the buffer being filled is mFilled % Buffers.
+    std::uint64_t mFilled = 0;
+    size_t mSize = 0;
+    Counter mRecorded;
+    Counter mDropped;
+
+    std::atomic<std::uint64_t> mFilledShared {};
+    std::atomic<std::uint64_t> mWritten {};
+    Counter mWrittenRecords;
+    std::atomic<bool> mIsFailed {};
+    std::atomic<bool> mIsStopped {};
+
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    std::thread mThread;
+};
+
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cassert>
+#include <functional>
+#include <type_traits>
+
+#include "CandidateBuffer.hpp"
+#include "ExtremesKernel.hpp"
+#include "OrderIndex.hpp"
+#include "QuoteStore.hpp"
+
+namespace top_stocks
+{
+
+// Selects the best stocks of the whole universe when a candidate set has to be restored: either walks the
+// order index, if there is one, or scans the contiguous quote store columns. A scan selects both the
+// gainers and the losers, the other side is served from the result until the quotes change.
+template <size_t Capacity>
+struct TopSelector
+{
+    using TGainers = CandidateBuffer<std::greater, Capacity>;
+    using TLosers = CandidateBuffer<std::less, Capacity>;
+
+    explicit TopSelector(const QuoteStore& aQuotes)
+        : mQuotes(aQuotes)
+    {
+
+    }
+
+    void SetIndex(const OrderIndex* aIndex)
+    {
+        mIndex = aIndex;
+    }
+
+    size_t Size() const
+    {
+        return mQuotes.Size();
+    }
+
+    // Must be called whenever the quotes change.
+    void Invalidate()
+    {
+        mIsValid = false;
+    }
+
+    // Fills the empty candidates up to their limit with the best stocks, the best first.
+    template <template <typename> typename TComparator, typename TCandidates>
+    void Select(TCandidates& aCandidates) const
+    {
+        assert(!aCandidates.Size());
+
+        if (mIndex)
+        {
+            mIndex->Visit(TComparator<TChange>()(1, 0),
+                [&aCandidates](const auto& e)
+                {
+                    aCandidates.Insert(e.first, e.second);
+                    return !aCandidates.IsFull();
+                }
+            );
+            return;
+        }
+
+        if (!mIsValid)
+        {
+            mGainers.Clear();
+            mLosers.Clear();
+            ExtremesKernel<TGainers, TLosers>::Run(mQuotes.Changes(), mQuotes.Ids(), mQuotes.Size(), mGainers, mLosers);
+            mIsValid = true;
+        }
+
+        if constexpr (std::is_same<TCandidates, TGainers>::value)
+        {
+            aCandidates.Assign(mGainers);
+        }
+        else
+        {
+            aCandidates.Assign(mLosers);
+        }
+    }
+
+private:
+
+    const QuoteStore& mQuotes;
+    const OrderIndex* mIndex = nullptr;
+
+    mutable TGainers mGainers;
+    mutable TLosers mLosers;
+    mutable bool mIsValid = false;
+};
+
+}
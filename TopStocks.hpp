@@ -1,120 +1,308 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <cassert>
+#include <cstdint>
+#include <cstdio>
 #include <iterator>
 #include <functional>
-#include <set>
-#include <unordered_map>
-
+#include <limits>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "CandidateBuffer.hpp"
+#include "ChangeModel.hpp"
+#include "Clock.hpp"
 #include "ITopStocks.hpp"
+#include "Metrics.hpp"
+#include "OrderIndex.hpp"
+#include "QuoteStore.hpp"
+#include "Snapshot.hpp"
+#include "TopSelector.hpp"
 
 namespace top_stocks
 {
 
-template <template <typename> typename TComparator>
+// Bounds and goal of the candidate set capacity tuning.
+struct AdaptiveCapacity
+{
+    size_t Min;
+    size_t Max;
+    // Restores per processed quote the capacity is tuned to.
+    double TargetRestoreRate;
+    // Processed quotes between two decisions.
+    size_t Window;
+};
+
+struct TopProcessorStats
+{
+    // The current capacity of the candidate set.
+    size_t Capacity;
+    std::uint64_t Quotes;
+    std::uint64_t Restores;
+    std::uint64_t Grows;
+    std::uint64_t Shrinks;
+    // The least number of candidates during the last tuning window.
+    size_t MinDepth;
+};
+
+// The capacity of the candidate set used by default for a top of the given size. It keeps the ratio of
+// TopStocks, but never less slack than TopStocks has, so that small tops are not restored on every drop.
+template <size_t K>
+constexpr size_t DefaultTopCapacity = std::max(K * TopMaxCapacity / TopSize, K + TopMaxCapacity - TopSize);
+
+// The notifier is called with the top list, or with the top list and its changes once the deltas are enabled.
+// Its type is known at compile time, so the calls may be inlined.
+template <template <typename> typename TComparator, size_t K, size_t Capacity, typename TNotifier>
 struct TopProcessor
 {
-    using TCallback = std::function<void(const TTopList&)>;
+    static_assert(0 < K && K <= Capacity, "The candidate set must fit the top");
+
+    using TTopList = TBasicTopList<K>;
 
-    TopProcessor(TChange aInitialThreshold, TCallback aCallback)
+    // The candidate set and its thresholds, a plain structure to be saved as is.
+    struct State
+    {
+        TChange Threshold;
+        TChange TopThreshold;
+        std::uint64_t Limit;
+        std::uint64_t Size;
+        std::array<TChange, Capacity> Changes;
+        std::array<TId, Capacity> Ids;
+        TId ThresholdId;
+    };
+
+    TopProcessor(TChange aInitialThreshold, TNotifier aNotifier, const IClock& aClock = SteadyClock::Instance())
         : mThreshold(aInitialThreshold)
         , mTopThreshold(aInitialThreshold)
-        , mCallback(aCallback)
+        , mNotifier(aNotifier)
+        , mClock(aClock)
     {
 
     }
 
-    template <typename TMap>
-    void Process(TId aStockId, TChange aOldPercent, TChange aNewPercent, const TMap& aMap)
+    void Process(TId aStockId, TChange aOldPercent, TChange aNewPercent, const TopSelector<Capacity>& aSelector)
     {
+        ++mStats.Quotes;
+
         if (!TComparator<TChange>()(mThreshold, aOldPercent))
         {
-            mContainer.erase({aOldPercent, aStockId});
+            mContainer.Erase(aOldPercent, aStockId);
         }
 
-        if (!TComparator<TChange>()(mThreshold, aNewPercent))
+        if (IsCandidate(aNewPercent, aStockId) && mContainer.Insert(aNewPercent, aStockId))
         {
-            mContainer.emplace(aNewPercent, aStockId);
+            // The worst candidate was dropped, the stocks outside are not better than the new worst one.
+            SetThreshold(mContainer.Back());
         }
 
+        mWindowMinDepth = std::min(mWindowMinDepth, mContainer.Size());
+
         if (!TComparator<TChange>()(mTopThreshold, aOldPercent) || !TComparator<TChange>()(mTopThreshold, aNewPercent))
         {
-            TTopList topList;
-
-            if (mContainer.size() >= TopSize)
+            if (mContainer.Size() < K)
             {
-                size_t i = 0;
-                auto it = mContainer.cbegin();
-                for (; i < topList.size(); ++i, ++it)
-                {
-                    topList[i] = {it->second, it->first};
-                }
-
-                if (TopMaxCapacity < mContainer.size())
-                {
-                    std::advance(it, TopMaxCapacity - i - 1);
-                    mThreshold = it->first;
-                    mContainer.erase(++it, mContainer.end());
-                }
-                mTopThreshold = topList.back().second;
+                // Assumed be rare or when there are a few stocks.
+                mRestores.Increment();
+                ++mWindowRestores;
+
+                assert(aSelector.Size() >= K);
+                mContainer.Clear();
+                aSelector.template Select<TComparator>(mContainer);
+                SetThreshold(mContainer.Back());
             }
-            else
+
+            for (size_t i = 0; i < mTopList.size(); ++i)
             {
-                // Assumed be rare or when there are a few stocks.
-                std::cout << "Warning: " << "Restoring the top." << std::endl;
-
-                assert(aMap.size() >= TopSize);
-                std::array<std::pair<TMap::key_type, TMap::mapped_type>, TopSize> temp;
-                auto mapComparator = [](const auto& l, const auto& r)
-                {
-                    return TComparator<std::pair<TChange, TId>>()(
-                        std::make_pair(l.second.second, l.first), std::make_pair(r.second.second, r.first));
-                };
-
-                std::partial_sort_copy(aMap.cbegin(), aMap.cend(), temp.begin(), temp.end(), mapComparator);
-                std::transform(temp.cbegin(), temp.cend(), topList.begin(),
-                    [](const auto& e)
-                    {
-                        return TQuote{e.first, e.second.second};
-                    }
-                );
-
-                mContainer.clear();
-                for (const auto& e : temp)
-                {
-                    mContainer.emplace(e.second.second, e.first);
-                }
+                mTopList[i] = {mContainer.Ids()[i], mContainer.Changes()[i]};
             }
+            mTopThreshold = mTopList.back().second;
 
             if (TComparator<TChange>()(aOldPercent, mTopThreshold)
                 || TComparator<TChange>()(aNewPercent, mTopThreshold)
-                || aOldPercent == mTopThreshold && TComparator<TChange>()(aOldPercent, aNewPercent))
+                || (aOldPercent == mTopThreshold && TComparator<TChange>()(aOldPercent, aNewPercent))
+                || (aNewPercent == mTopThreshold && TComparator<TChange>()(aNewPercent, aOldPercent))
+                || (mIsNotifyingTies && aNewPercent == mTopThreshold && aOldPercent == aNewPercent
+                    && IsInTop(aStockId)))
             {
-                mCallback(topList);
+                Notify();
             }
         }
+
+        if (mAdaptiveCapacity.Window && ++mWindowQuotes == mAdaptiveCapacity.Window)
+        {
+            Adapt();
+        }
+    }
+
+    void Copy(const QuoteStore& aQuotes)
+    {
+        assert(aQuotes.Size() <= K);
+
+        mContainer.Clear();
+        for (size_t i = 0; i < aQuotes.Size(); ++i)
+        {
+            mContainer.Insert(aQuotes.Changes()[i], aQuotes.Ids()[i]);
+        }
+        SetThreshold(mContainer.Back());
+        mTopThreshold = mThreshold;
+
+        mTopList = {};
+        for (size_t i = 0; i < mContainer.Size(); ++i)
+        {
+            mTopList[i] = {mContainer.Ids()[i], mContainer.Changes()[i]};
+        }
+
+        Notify();
+    }
+
+    State Save() const
+    {
+        State state {};
+        state.Threshold = mThreshold;
+        state.ThresholdId = mThresholdId;
+        state.TopThreshold = mTopThreshold;
+        state.Limit = mContainer.Limit();
+        state.Size = mContainer.Size();
+        std::copy_n(mContainer.Changes(), mContainer.Size(), state.Changes.begin());
+        std::copy_n(mContainer.Ids(), mContainer.Size(), state.Ids.begin());
+        return state;
+    }
+
+    // Whether the state fits the candidate set, e.g. one read from a file.
+    static bool IsValid(const State& aState)
+    {
+        return 0 < aState.Limit && aState.Limit <= Capacity && aState.Size <= aState.Limit;
     }
 
-    template <typename TMap>
-    void Copy(const TMap& aMap)
+    // The restored top is notified once.
+    void Restore(const State& aState)
     {
-        mContainer.clear();
-        for (const auto& e : aMap)
+        assert(IsValid(aState));
+
+        mContainer.Clear();
+        mContainer.SetLimit(aState.Limit);
+        for (size_t i = 0; i < aState.Size; ++i)
         {
-            mContainer.emplace(e.second.second, e.first);
-            mTopThreshold = mThreshold = e.second.second;
+            mContainer.Insert(aState.Changes[i], aState.Ids[i]);
         }
-        assert(mContainer.size() <= TopSize);
+        mThreshold = aState.Threshold;
+        mThresholdId = aState.ThresholdId;
+        mTopThreshold = aState.TopThreshold;
 
-        TTopList topList;
-        std::transform(mContainer.cbegin(), mContainer.cend(), topList.begin(),
-            [](const auto& e)
-            {
-                return TQuote{e.second, e.first};
-            }
-        );
+        mTopList = {};
+        for (size_t i = 0; i < std::min(K, mContainer.Size()); ++i)
+        {
+            mTopList[i] = {mContainer.Ids()[i], mContainer.Changes()[i]};
+        }
 
-        mCallback(topList);
+        Notify();
+    }
+
+    // Tunes the candidate set capacity within the bounds: it grows while the restore rate is above the target
+    // and shrinks by a half of the candidates which were never drained while the rate is well below it.
+    void SetAdaptiveCapacity(const AdaptiveCapacity& aAdaptiveCapacity)
+    {
+        assert(K <= aAdaptiveCapacity.Min && aAdaptiveCapacity.Min <= aAdaptiveCapacity.Max);
+        assert(aAdaptiveCapacity.Max <= Capacity && aAdaptiveCapacity.Window);
+
+        mAdaptiveCapacity = aAdaptiveCapacity;
+        Resize(std::min(std::max(mContainer.Limit(), mAdaptiveCapacity.Min), mAdaptiveCapacity.Max));
+        ResetWindow();
+    }
+
+    void EnableDeltas(bool aIsEnabled)
+    {
+        mIsDelta = aIsEnabled;
+        mDeltas.reserve(2 * K);
+    }
+
+    // Drops the notifications of a top equal to the last notified one, they are counted as suppressed.
+    void EnableSuppression(bool aIsEnabled)
+    {
+        mIsSuppressing = aIsEnabled;
+    }
+
+    // Notifies a stock entering the top at the threshold itself with its change unchanged, e.g. a new stock
+    // at 0% ordered by id among ties, which is not notified otherwise.
+    void EnableTieNotifications(bool aIsEnabled)
+    {
+        mIsNotifyingTies = aIsEnabled;
+    }
+
+    TopProcessorStats Stats() const
+    {
+        auto stats = mStats;
+        stats.Capacity = mContainer.Limit();
+        stats.Restores = mRestores.Load();
+        return stats;
+    }
+
+    // Times the callbacks. Counters are always maintained.
+    void EnableLatencyMetrics(bool aIsEnabled)
+    {
+        mIsTimed = aIsEnabled;
+    }
+
+    // May be called from any thread.
+    TopSideMetrics Metrics() const
+    {
+        return {mRestores.Load(), mNotifications.Load(), mSpuriousNotifications.Load(),
+            mSuppressedNotifications.Load(), mCallbackLatency.Snapshot()};
+    }
+
+    // Until the batch ends notifications only mark the top dirty, then the final top is notified once.
+    void BeginBatch()
+    {
+        mIsBatching = true;
+    }
+
+    void EndBatch()
+    {
+        mIsBatching = false;
+        Poll();
+    }
+
+    // A non-zero interval conflates notifications: within the interval after a notification changes only
+    // mark the top dirty, the latest top is notified by the first Process or Poll after the interval.
+    void SetConflation(TDuration aInterval)
+    {
+        mInterval = aInterval;
+    }
+
+    // Notifies the pending top if the conflation interval has elapsed.
+    void Poll()
+    {
+        if (!IsPending())
+        {
+            return;
+        }
+
+        if (mInterval == TDuration::zero())
+        {
+            Deliver();
+            return;
+        }
+
+        auto now = mClock.Now();
+        if (mLastDelivery + mInterval <= now)
+        {
+            mLastDelivery = now;
+            Deliver();
+        }
+    }
+
+    // Notifies the pending top regardless of the conflation interval.
+    void Flush()
+    {
+        if (IsPending())
+        {
+            mLastDelivery = mClock.Now();
+            Deliver();
+        }
     }
 
 
@@ -122,90 +310,699 @@ private:
 
     using TTopElement = std::pair<TChange, TId>;
 
-    std::set<TTopElement, TComparator<TTopElement>> mContainer;
+    void Notify()
+    {
+        mIsDirty = true;
+        if (!mIsBatching)
+        {
+            Poll();
+        }
+    }
+
+    bool IsInTop(TId aStockId) const
+    {
+        return std::any_of(mTopList.begin(), mTopList.end(),
+            [aStockId](const auto& e) { return e.first == aStockId; });
+    }
+
+    // A dirty top equal to the published one is suppressed if enabled.
+    bool IsPending()
+    {
+        if (mIsDirty && mIsSuppressing && AreEqual(mTopList, mDeliveredTopList))
+        {
+            mIsDirty = false;
+            mSuppressedNotifications.Increment();
+        }
+        return mIsDirty;
+    }
+
+    // Compares all the ids and changes without branches, which the compiler vectorizes.
+    static bool AreEqual(const TTopList& aLeft, const TTopList& aRight)
+    {
+        bool isEqual = true;
+        for (size_t i = 0; i < K; ++i)
+        {
+            isEqual &= (aLeft[i].first == aRight[i].first) & (aLeft[i].second == aRight[i].second);
+        }
+        return isEqual;
+    }
+
+    void Deliver()
+    {
+        mIsDirty = false;
+
+        mNotifications.Increment();
+        if (AreEqual(mTopList, mDeliveredTopList))
+        {
+            mSpuriousNotifications.Increment();
+        }
+        if (mIsDelta)
+        {
+            Diff();
+        }
+        mDeliveredTopList = mTopList;
+
+        if (!mIsTimed)
+        {
+            Call();
+            return;
+        }
+
+        auto start = mClock.Now();
+        Call();
+        mCallbackLatency.Record(mClock.Now() - start);
+    }
+
+    void Call()
+    {
+        if (mIsDelta)
+        {
+            mNotifier(mTopList, Span<const TopChange>(mDeltas));
+        }
+        else
+        {
+            mNotifier(mTopList);
+        }
+    }
+
+    // Zero ids are the empty positions of a list of less than K stocks.
+    void Diff()
+    {
+        mDeltas.clear();
+
+        auto find = [](const TTopList& aTop, TId aStockId)
+        {
+            return static_cast<size_t>(std::find_if(aTop.begin(), aTop.end(),
+                [aStockId](const auto& e) { return e.first == aStockId; }) - aTop.begin());
+        };
+
+        for (size_t i = 0; i < K; ++i)
+        {
+            const auto& e = mDeliveredTopList[i];
+            if (e.first && find(mTopList, e.first) == K)
+            {
+                mDeltas.push_back({TopChangeKind::Left, e.first, i, i, e.second});
+            }
+        }
+
+        for (size_t i = 0; i < K; ++i)
+        {
+            const auto& e = mTopList[i];
+            if (!e.first)
+            {
+                continue;
+            }
+
+            size_t previous = find(mDeliveredTopList, e.first);
+            if (previous == K)
+            {
+                mDeltas.push_back({TopChangeKind::Entered, e.first, i, i, e.second});
+            }
+            else if (previous != i)
+            {
+                mDeltas.push_back({TopChangeKind::Moved, e.first, i, previous, e.second});
+            }
+            else if (mDeliveredTopList[i].second != e.second)
+            {
+                mDeltas.push_back({TopChangeKind::Updated, e.first, i, i, e.second});
+            }
+        }
+    }
 
+    void Adapt()
+    {
+        const auto& adaptive = mAdaptiveCapacity;
+        const double rate = static_cast<double>(mWindowRestores) / mWindowQuotes;
+        const size_t limit = mContainer.Limit();
+
+        if (rate > adaptive.TargetRestoreRate && limit < adaptive.Max)
+        {
+            Resize(std::min(limit + std::max<size_t>(limit / 4, 1), adaptive.Max));
+            ++mStats.Grows;
+        }
+        else if (rate <= adaptive.TargetRestoreRate / 2 && mWindowMinDepth > K && limit > adaptive.Min)
+        {
+            Resize(std::max(limit - std::max<size_t>((mWindowMinDepth - K) / 2, 1), adaptive.Min));
+            ++mStats.Shrinks;
+        }
+
+        mStats.MinDepth = mWindowMinDepth;
+        ResetWindow();
+    }
+
+    void Resize(size_t aLimit)
+    {
+        bool isFull = mContainer.Size() >= aLimit;
+        mContainer.SetLimit(aLimit);
+        if (isFull && mContainer.Size())
+        {
+            SetThreshold(mContainer.Back());
+        }
+    }
+
+    // Whether the stock is not worse than the threshold, ties ordered by id as in the candidate set.
+    bool IsCandidate(TChange aPercent, TId aStockId) const
+    {
+        return TComparator<TChange>()(aPercent, mThreshold)
+            || (aPercent == mThreshold && !TComparator<TId>()(mThresholdId, aStockId));
+    }
+
+    void SetThreshold(const std::pair<TChange, TId>& aElement)
+    {
+        mThreshold = aElement.first;
+        mThresholdId = aElement.second;
+    }
+
+    void ResetWindow()
+    {
+        mWindowQuotes = 0;
+        mWindowRestores = 0;
+        mWindowMinDepth = Capacity;
+    }
+
+    CandidateBuffer<TComparator, Capacity> mContainer;
+
+    // The worst candidate kept when the set was last full or restored, the stocks outside are worse.
     TChange mThreshold {};
+    TId mThresholdId {};
     TChange mTopThreshold {};
 
-    std::function<void(const TTopList&)> mCallback;
-
-    static const constexpr size_t TopMaxCapacity = 16;
+    TNotifier mNotifier;
+
+    TTopList mTopList {};
+    bool mIsBatching = false;
+    bool mIsDirty = false;
+
+    const IClock& mClock;
+    TDuration mInterval {};
+    TTimePoint mLastDelivery = TTimePoint::min();
+
+    AdaptiveCapacity mAdaptiveCapacity {};
+    TopProcessorStats mStats {};
+    size_t mWindowQuotes = 0;
+    size_t mWindowRestores = 0;
+    size_t mWindowMinDepth = Capacity;
+
+    TTopList mDeliveredTopList {};
+    bool mIsSuppressing = false;
+    bool mIsNotifyingTies = false;
+    bool mIsDelta = false;
+    std::vector<TopChange> mDeltas;
+    bool mIsTimed = false;
+    Counter mRestores;
+    Counter mNotifications;
+    Counter mSpuriousNotifications;
+    Counter mSuppressedNotifications;
+    LatencyHistogram mCallbackLatency;
 };
 
-struct TopStocks : ITopStocks
+// Top K gainers and losers with candidate sets of the given capacity. Instances of different K may coexist.
+// The changes are computed by the change model, in percent by default. The handler is any type with the
+// methods of IBasicTopStocksHandler<K>, the interface itself by default; a final implementation of it gets
+// its notifications bound statically, without virtual calls.
+template <size_t K, size_t Capacity = DefaultTopCapacity<K>, typename TChangeModel = PercentChange,
+    typename THandler = IBasicTopStocksHandler<K>>
+struct BasicTopStocks : ITopStocks
 {
-    TopStocks(ITopStocksHandler& aHandler)
+    using TTopList = TBasicTopList<K>;
+
+    BasicTopStocks(THandler& aHandler, TId aDenseIdLimit = QuoteStore::DefaultDenseLimit,
+        const IClock& aClock = SteadyClock::Instance())
         : mHander(aHandler)
-        , mGainers(std::numeric_limits<TChange>::min(),
-            std::bind(&ITopStocksHandler::ProcessTopGainersChanged, std::ref(mHander), std::placeholders::_1))
-        , mLosers(std::numeric_limits<TChange>::max(),
-            std::bind(&ITopStocksHandler::ProcessTopLosersChanged, std::ref(mHander), std::placeholders::_1))
+        , mClock(aClock)
+        , mQuotes(aDenseIdLimit)
+        , mSelector(mQuotes)
+        , mGainers(std::numeric_limits<TChange>::min(), GainersNotifier {&aHandler}, aClock)
+        , mLosers(std::numeric_limits<TChange>::max(), LosersNotifier {&aHandler}, aClock)
+    {
+
+    }
+
+    // The selector refers to the quotes of the instance.
+    BasicTopStocks(const BasicTopStocks&) = delete;
+    BasicTopStocks(BasicTopStocks&&) = delete;
+    BasicTopStocks& operator=(const BasicTopStocks&) = delete;
+    BasicTopStocks& operator=(BasicTopStocks&&) = delete;
+
+    // Limits the gainers notifications to one per interval, zero disables the conflation.
+    void SetGainersConflation(TDuration aInterval)
+    {
+        mGainers.SetConflation(aInterval);
+    }
+
+    // Limits the losers notifications to one per interval, zero disables the conflation.
+    void SetLosersConflation(TDuration aInterval)
+    {
+        mLosers.SetConflation(aInterval);
+    }
+
+    // The order index keeps all the stocks ordered, which costs O(log N) per quote, but bounds the top
+    // restoration by O(log N) instead of the O(N) scan.
+    void EnableOrderIndex(bool aIsEnabled)
+    {
+        if (!aIsEnabled)
+        {
+            mIndex.reset();
+        }
+        else if (!mIndex)
+        {
+            BuildIndex();
+        }
+        mSelector.SetIndex(mIndex.get());
+    }
+
+    // The position of the stock among the gainers, 1 for the top gainer, or 0 if the stock is unknown.
+    // The queries need the order index, without it they return nothing. They cost O(log N) plus the number
+    // of returned stocks and should be called from the thread processing the quotes.
+    size_t RankOf(TId aStockId) const
+    {
+        auto slot = aStockId > 0 ? mQuotes.Find(aStockId) : QuoteStore::NoSlot;
+        if (!mIndex || slot == QuoteStore::NoSlot)
+        {
+            return 0;
+        }
+        return mIndex->Rank(slot, true) + 1;
+    }
+
+    // The gainers at the positions from 1-based aFrom to aTo inclusive, fewer if there are fewer stocks.
+    std::vector<TQuote> Range(size_t aFrom, size_t aTo) const
+    {
+        return Query(true, aFrom, aTo);
+    }
+
+    // The best gainers, the best first.
+    std::vector<TQuote> Top(size_t aCount) const
+    {
+        return Query(true, 1, aCount);
+    }
+
+    // The worst losers, the worst first.
+    std::vector<TQuote> Bottom(size_t aCount) const
+    {
+        return Query(false, 1, aCount);
+    }
+
+    // Writes the base and the change of every stock and both candidate sets. Returns false on an I/O error.
+    bool SaveSnapshot(const std::string& aPath) const
+    {
+        std::unique_ptr<std::FILE, int (*)(std::FILE*)> file(std::fopen(aPath.c_str(), "wb"), &std::fclose);
+        if (!file)
+        {
+            return false;
+        }
+
+        SnapshotHeader header {};
+        std::copy(std::begin(SnapshotHeader::Signature), std::end(SnapshotHeader::Signature), header.Magic);
+        header.Version = SnapshotHeader::CurrentVersion;
+        header.TopSize = K;
+        header.Capacity = Capacity;
+        header.ChangeUnits = TChangeModel::PerPercent;
+        header.Stocks = mQuotes.Size();
+
+        auto gainers = mGainers.Save();
+        auto losers = mLosers.Save();
+        return details::Write(file.get(), &header, 1)
+            && details::Write(file.get(), mQuotes.Ids(), mQuotes.Size())
+            && details::Write(file.get(), mQuotes.Bases(), mQuotes.Size())
+            && details::Write(file.get(), mQuotes.Changes(), mQuotes.Size())
+            && details::Write(file.get(), &gainers, 1)
+            && details::Write(file.get(), &losers, 1)
+            && !std::fflush(file.get());
+    }
+
+    // Replaces the whole state in one pass, the restored tops are notified once per side. Returns false,
+    // keeping the state, if the file cannot be read, is truncated or inconsistent, or was saved by an engine
+    // of another top size or capacity.
+    bool LoadSnapshot(const std::string& aPath)
+    {
+        std::unique_ptr<std::FILE, int (*)(std::FILE*)> file(std::fopen(aPath.c_str(), "rb"), &std::fclose);
+        if (!file)
+        {
+            return false;
+        }
+
+        SnapshotHeader header {};
+        if (!details::Read(file.get(), &header, 1)
+            || !std::equal(header.Magic, header.Magic + sizeof(header.Magic), SnapshotHeader::Signature)
+            || header.Version != SnapshotHeader::CurrentVersion
+            || header.TopSize != K || header.Capacity != Capacity || header.ChangeUnits != TChangeModel::PerPercent)
+        {
+            return false;
+        }
+
+        // The columns and the states should fill the rest of the file exactly.
+        const std::uint64_t statesSize = sizeof(typename TGainers::State) + sizeof(typename TLosers::State);
+        const std::uint64_t stockSize = sizeof(TId) + sizeof(TBase) + sizeof(TChange);
+        std::uint64_t remaining = 0;
+        if (!details::RemainingSize(file.get(), remaining) || remaining < statesSize
+            || (remaining - statesSize) % stockSize || (remaining - statesSize) / stockSize != header.Stocks)
+        {
+            return false;
+        }
+
+        size_t size = static_cast<size_t>(header.Stocks);
+        std::vector<TId> ids(size);
+        std::vector<TBase> bases(size);
+        std::vector<TChange> changes(size);
+        typename TGainers::State gainers {};
+        typename TLosers::State losers {};
+        if (!details::Read(file.get(), ids.data(), size)
+            || !details::Read(file.get(), bases.data(), size)
+            || !details::Read(file.get(), changes.data(), size)
+            || !details::Read(file.get(), &gainers, 1)
+            || !details::Read(file.get(), &losers, 1)
+            || !TGainers::IsValid(gainers) || !TLosers::IsValid(losers))
+        {
+            return false;
+        }
+
+        std::vector<TId> sortedIds(ids);
+        std::sort(sortedIds.begin(), sortedIds.end());
+        if ((!sortedIds.empty() && sortedIds.front() <= 0)
+            || std::adjacent_find(sortedIds.begin(), sortedIds.end()) != sortedIds.end())
+        {
+            return false;
+        }
+
+        mQuotes.Clear();
+        mQuotes.Reserve(size);
+        mScales.Clear();
+        for (size_t i = 0; i < size; ++i)
+        {
+            auto slot = mQuotes.Insert(ids[i], bases[i], changes[i]);
+            mScales.SetBase(mQuotes, slot, bases[i]);
+        }
+
+        if (mIndex)
+        {
+            BuildIndex();
+            mSelector.SetIndex(mIndex.get());
+        }
+        mSelector.Invalidate();
+
+        mGainers.Restore(gainers);
+        mLosers.Restore(losers);
+        return true;
+    }
+
+    // Tunes the capacity of both candidate sets, see TopProcessor::SetAdaptiveCapacity.
+    void SetAdaptiveCapacity(const AdaptiveCapacity& aAdaptiveCapacity)
+    {
+        mGainers.SetAdaptiveCapacity(aAdaptiveCapacity);
+        mLosers.SetAdaptiveCapacity(aAdaptiveCapacity);
+    }
+
+    TopProcessorStats GainersStats() const
+    {
+        return mGainers.Stats();
+    }
+
+    TopProcessorStats LosersStats() const
+    {
+        return mLosers.Stats();
+    }
+
+    // Notifies the changes between the consecutive lists through the delta callbacks of the handler instead
+    // of the full list callbacks.
+    void EnableDeltas(bool aIsEnabled)
+    {
+        mGainers.EnableDeltas(aIsEnabled);
+        mLosers.EnableDeltas(aIsEnabled);
+    }
+
+    // Drops the notifications of a top equal to the last notified one on its side, e.g. when a quote at the
+    // threshold leaves the top as it was. The dropped ones are counted by the metrics.
+    void EnableSuppression(bool aIsEnabled)
+    {
+        mGainers.EnableSuppression(aIsEnabled);
+        mLosers.EnableSuppression(aIsEnabled);
+    }
+
+    // Notifies the stocks entering a top at its threshold with an unchanged change, e.g. new stocks at 0% when
+    // the top is all ties, see TopProcessor::EnableTieNotifications. Off by default.
+    void EnableTieNotifications(bool aIsEnabled)
+    {
+        mGainers.EnableTieNotifications(aIsEnabled);
+        mLosers.EnableTieNotifications(aIsEnabled);
+    }
+
+    // Latency histograms read the clock twice per quote, batch and callback. Counters are always maintained.
+    void EnableLatencyMetrics(bool aIsEnabled)
+    {
+        mIsTimed = aIsEnabled;
+        mGainers.EnableLatencyMetrics(aIsEnabled);
+        mLosers.EnableLatencyMetrics(aIsEnabled);
+    }
+
+    // May be called from any thread while quotes are processed.
+    TopStocksMetrics Metrics() const
+    {
+        return {
+            mTicks.Load(),
+            mIgnoredTicks.Load(),
+            mGainers.Metrics(),
+            mLosers.Metrics(),
+            mQuoteLatency.Snapshot(),
+            mBatchLatency.Snapshot(),
+        };
+    }
+
+    // Notifies the conflated tops whose interval has elapsed. Should be called periodically when conflating.
+    void Poll()
+    {
+        mGainers.Poll();
+        mLosers.Poll();
+    }
+
+    // Notifies all the conflated tops immediately.
+    void Flush()
+    {
+        mGainers.Flush();
+        mLosers.Flush();
+    }
+
+    // Moves the base of a known stock and recomputes its change from the given price, e.g. when the
+    // reference price of a rolling window ages. Unknown or invalid stocks and non-positive bases are ignored.
+    void Rebase(TId aStockId, TBase aBase, double aPrice)
+    {
+        if (aStockId <= 0 || aBase <= 0)
+        {
+            return;
+        }
+
+        auto slot = mQuotes.Find(aStockId);
+        if (slot == QuoteStore::NoSlot)
+        {
+            return;
+        }
+
+        mScales.SetBase(mQuotes, slot, aBase);
+        auto newPercent = TChangeModel::Change(aPrice, mScales.Scale(mQuotes, slot));
+        auto oldPercent = std::exchange(mQuotes.Change(slot), newPercent);
+        Publish(aStockId, slot, oldPercent);
+    }
+
+    // Notifications of the quotes and rebases until EndBatch are held back and notified once per side.
+    void BeginBatch()
+    {
+        mGainers.BeginBatch();
+        mLosers.BeginBatch();
+    }
+
+    void EndBatch()
+    {
+        mGainers.EndBatch();
+        mLosers.EndBatch();
+    }
+
+    void OnQuote(int aStockId, double aPrice) final
+    {
+        if (!mIsTimed)
+        {
+            Apply(aStockId, aPrice);
+            return;
+        }
+
+        auto start = mClock.Now();
+        Apply(aStockId, aPrice);
+        mQuoteLatency.Record(mClock.Now() - start);
+    }
+
+    void OnQuotes(Span<const Quote> aQuotes) final
+    {
+        TTimePoint start = mIsTimed ? mClock.Now() : TTimePoint();
+
+        BeginBatch();
+        for (const auto& quote : aQuotes)
+        {
+            Apply(quote.StockId, quote.Price);
+        }
+        EndBatch();
+
+        if (mIsTimed)
+        {
+            mBatchLatency.Record(mClock.Now() - start);
+        }
+    }
+
+private:
+
+    struct GainersNotifier
+    {
+        void operator()(const TTopList& aTop) const
+        {
+            mHandler->ProcessTopGainersChanged(aTop);
+        }
+
+        void operator()(const TTopList& aTop, Span<const TopChange> aChanges) const
+        {
+            mHandler->ProcessTopGainersDelta(aTop, aChanges);
+        }
+
+        THandler* mHandler;
+    };
+
+    struct LosersNotifier
     {
+        void operator()(const TTopList& aTop) const
+        {
+            mHandler->ProcessTopLosersChanged(aTop);
+        }
+
+        void operator()(const TTopList& aTop, Span<const TopChange> aChanges) const
+        {
+            mHandler->ProcessTopLosersDelta(aTop, aChanges);
+        }
+
+        THandler* mHandler;
+    };
+
+    using TGainers = TopProcessor<std::greater, K, Capacity, GainersNotifier>;
+    using TLosers = TopProcessor<std::less, K, Capacity, LosersNotifier>;
+
+    std::vector<TQuote> Query(bool aIsDescending, size_t aFrom, size_t aTo) const
+    {
+        std::vector<TQuote> result;
+        if (!mIndex || !aFrom || aFrom > aTo)
+        {
+            return result;
+        }
 
+        result.reserve(std::min(aTo, mIndex->Size()) - std::min(aFrom - 1, mIndex->Size()));
+        mIndex->Visit(aIsDescending, aFrom - 1,
+            [&result, aFrom, aTo](const auto& e)
+            {
+                result.emplace_back(e.second, e.first);
+                return result.size() < aTo - aFrom + 1;
+            }
+        );
+        return result;
     }
 
-    void OnQuote(int aStockId, double aPrice) override
+    void BuildIndex()
     {
+        mIndex.reset(new OrderIndex);
+        for (size_t i = 0; i < mQuotes.Size(); ++i)
+        {
+            mIndex->Insert(static_cast<OrderIndex::TNode>(i), mQuotes.Changes()[i], mQuotes.Ids()[i]);
+        }
+    }
+
+    void Apply(TId aStockId, double aPrice)
+    {
+        mTicks.Increment();
+
         if (aStockId <= 0)
         {
+            mIgnoredTicks.Increment();
             return;
         }
 
-        TChange oldPercent = 0, newPercent = 0;
+        TChange oldPercent = 0;
 
-        auto quoteIterator = mQuotes.find(aStockId);
-        if (quoteIterator == mQuotes.cend())
+        auto slot = mQuotes.Find(aStockId);
+        if (slot == QuoteStore::NoSlot)
         {
             if (aPrice <= 0)
             {
+                mIgnoredTicks.Increment();
                 return;
             }
 
-            quoteIterator = mQuotes.emplace(
-                std::piecewise_construct,
-                std::forward_as_tuple(aStockId),
-                std::forward_as_tuple(aPrice, 0.)).first;
+            slot = mQuotes.Insert(aStockId, aPrice, 0.);
+            mScales.SetBase(mQuotes, slot, aPrice);
+            if (mIndex)
+            {
+                mIndex->Insert(slot, 0., aStockId);
+            }
         }
         else
         {
-            auto& quote = quoteIterator->second;
+            auto& change = mQuotes.Change(slot);
 
             if (aPrice <= 0)
             {
-                quote.first = 0;
+                mScales.SetBase(mQuotes, slot, 0);
             }
 
-            if (quote.first)
+            if (mQuotes.Base(slot))
             {
-                oldPercent = std::exchange(quote.second, (aPrice - quote.first) / quote.first * 100);
+                oldPercent = std::exchange(change, TChangeModel::Change(aPrice, mScales.Scale(mQuotes, slot)));
             }
             else
             {
-                oldPercent = std::exchange(quote.second, 0);
+                oldPercent = std::exchange(change, 0);
             }
-            newPercent = quote.second;
         }
 
-        if (mQuotes.size() <= TopSize)
+        Publish(aStockId, slot, oldPercent);
+    }
+
+    // Brings the index and both tops up to date with the changed stock.
+    void Publish(TId aStockId, QuoteStore::TSlot aSlot, TChange aOldPercent)
+    {
+        auto newPercent = mQuotes.Change(aSlot);
+        if (mIndex)
+        {
+            mIndex->Update(aSlot, newPercent);
+        }
+
+        mSelector.Invalidate();
+
+        if (mQuotes.Size() <= K)
         {
             mGainers.Copy(mQuotes);
             mLosers.Copy(mQuotes);
         }
         else
         {
-            mGainers.Process(aStockId, oldPercent, newPercent, mQuotes);
-            mLosers.Process(aStockId, oldPercent, newPercent, mQuotes);
+            mGainers.Process(aStockId, aOldPercent, newPercent, mSelector);
+            mLosers.Process(aStockId, aOldPercent, newPercent, mSelector);
         }
     }
 
-private:
+    THandler& mHander;
+    const IClock& mClock;
 
-    ITopStocksHandler& mHander;
+    QuoteStore mQuotes;
+    ScaleColumn<TChangeModel> mScales;
+    std::unique_ptr<OrderIndex> mIndex;
+    TopSelector<Capacity> mSelector;
 
-    std::unordered_map<TId, std::pair<TBase, TChange>> mQuotes;
+    TGainers mGainers;
+    TLosers mLosers;
 
-    TopProcessor<std::greater> mGainers;
-    TopProcessor<std::less> mLosers;
+    bool mIsTimed = false;
+    Counter mTicks;
+    Counter mIgnoredTicks;
+    LatencyHistogram mQuoteLatency;
+    LatencyHistogram mBatchLatency;
 };
 
+using TopStocks = BasicTopStocks<TopSize, TopMaxCapacity>;
+
+// TopStocks notifying a handler of a known type, e.g. a final ITopStocksHandler, without virtual calls.
+template <typename THandler>
+using StaticTopStocks = BasicTopStocks<TopSize, TopMaxCapacity, PercentChange, THandler>;
+
 }
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+#include "Clock.hpp"
+#include "ITopStocks.hpp"
+
+namespace top_stocks
+{
+
+// Receives the tops trimmed to the size it has subscribed with.
+struct ITopSubscriber
+{
+    virtual ~ITopSubscriber() = default;
+
+    virtual void ProcessTopGainersChanged(Span<const TQuote> aTop) = 0;
+
+    virtual void ProcessTopLosersChanged(Span<const TQuote> aTop) = 0;
+};
+
+// Fans the tops of one engine out to several subscribers, each with its own top size up to K and its own
+// minimal interval between notifications. The engine ranks once per quote for all of them: it is created
+// with this handler and the largest top size. A subscriber is notified only if its trimmed top changed;
+// within its interval the latest top is held back and notified by Poll or Flush.
+template <size_t K = TopSize>
+struct BasicTopSubscriptions : IBasicTopStocksHandler<K>
+{
+    using TTopList = TBasicTopList<K>;
+
+    explicit BasicTopSubscriptions(const IClock& aClock = SteadyClock::Instance())
+        : mClock(aClock)
+    {
+
+    }
+
+    // Zero interval notifies every change. Returns the id to unsubscribe with.
+    size_t Subscribe(ITopSubscriber& aSubscriber, size_t aTopSize, TDuration aInterval = TDuration::zero())
+    {
+        assert(0 < aTopSize && aTopSize <= K);
+
+        mSubscribers.push_back({&aSubscriber, aTopSize, aInterval, {}});
+        return mSubscribers.size() - 1;
+    }
+
+    // Nothing more is notified to the subscriber, the id is not reused.
+    void Unsubscribe(size_t aId)
+    {
+        mSubscribers[aId].Subscriber = nullptr;
+    }
+
+    void ProcessTopGainersChanged(const TTopList& aTop) override
+    {
+        mLatest[Gainers] = aTop;
+        Update(Gainers, false);
+    }
+
+    void ProcessTopLosersChanged(const TTopList& aTop) override
+    {
+        mLatest[Losers] = aTop;
+        Update(Losers, false);
+    }
+
+    // Notifies the held back tops whose interval has elapsed. Should be called periodically when throttling.
+    void Poll()
+    {
+        Update(Gainers, false);
+        Update(Losers, false);
+    }
+
+    // Notifies all the held back tops immediately.
+    void Flush()
+    {
+        Update(Gainers, true);
+        Update(Losers, true);
+    }
+
+private:
+
+    enum Side
+    {
+        Gainers,
+        Losers,
+    };
+
+    struct Delivery
+    {
+        TTopList Top {};
+        TTimePoint Time = TTimePoint::min();
+    };
+
+    struct Subscription
+    {
+        ITopSubscriber* Subscriber;
+        size_t TopSize;
+        TDuration Interval;
+        Delivery Deliveries[2];
+    };
+
+    void Update(Side aSide, bool aIsForced)
+    {
+        const auto& latest = mLatest[aSide];
+        TTimePoint now = {};
+        bool isNowRead = false;
+
+        for (auto& subscription : mSubscribers)
+        {
+            auto& delivery = subscription.Deliveries[aSide];
+            if (!subscription.Subscriber
+                || std::equal(latest.begin(), latest.begin() + subscription.TopSize, delivery.Top.begin()))
+            {
+                continue;
+            }
+
+            if (subscription.Interval != TDuration::zero())
+            {
+                if (!isNowRead)
+                {
+                    now = mClock.Now();
+                    isNowRead = true;
+                }
+
+                if (!aIsForced && delivery.Time != TTimePoint::min() && now - delivery.Time < subscription.Interval)
+                {
+                    continue;
+                }
+                delivery.Time = now;
+            }
+
+            std::copy_n(latest.begin(), subscription.TopSize, delivery.Top.begin());
+            Span<const TQuote> top(delivery.Top.data(), subscription.TopSize);
+            if (aSide == Gainers)
+            {
+                subscription.Subscriber->ProcessTopGainersChanged(top);
+            }
+            else
+            {
+                subscription.Subscriber->ProcessTopLosersChanged(top);
+            }
+        }
+    }
+
+    const IClock& mClock;
+
+    TTopList mLatest[2] {};
+    std::vector<Subscription> mSubscribers;
+};
+
+using TopSubscriptions = BasicTopSubscriptions<TopSize>;
+
+}
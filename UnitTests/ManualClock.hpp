@@ -0,0 +1,29 @@
+#pragma once
+
+#include "../Clock.hpp"
+
+namespace top_stocks
+{
+
+namespace tests
+{
+
+struct ManualClock : IClock
+{
+    TTimePoint Now() const override
+    {
+        return mNow;
+    }
+
+    void Advance(TDuration aDuration)
+    {
+        mNow += aDuration;
+    }
+
+private:
+
+    TTimePoint mNow {};
+};
+
+}
+}
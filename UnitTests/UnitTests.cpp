@@ -1,6 +1,25 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <filesystem>
 #include <iostream>
-
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../Display/TerminalRenderer.hpp"
+#include "../Display/TripleBuffer.hpp"
+#include "../GroupedTopStocks.hpp"
+#include "../MappedJournal.hpp"
+#include "../QueuedTopStocks.hpp"
+#include "../RecordingTopStocks.hpp"
+#include "../Replay/TopListLog.hpp"
+#include "../ShardedTopStocks.hpp"
 #include "../TopStocks.hpp"
+#include "../TopSubscriptions.hpp"
+#include "../WindowedTopStocks.hpp"
+#include "ManualClock.hpp"
 #include "TopStocksHandlerMock.hpp"
 
 namespace top_stocks
@@ -61,6 +80,8 @@ void ShouldIgnoreIncorrectId()
     topStocks.OnQuote(-42, 123);
     topStocks.OnQuote(0, 112.3);
     topStocks.OnQuote(0, 11);
+    topStocks.Rebase(-42, 100, 123);
+    topStocks.Rebase(0, 11, 112.3);
 }
 
 void ShouldResetIncorrectPrices()
@@ -399,6 +420,1583 @@ void ShouldOperateMoreThan20()
     topStocks.OnQuote(4, 100);
 }
 
+void ShouldSuppressUnchangedTop()
+{
+    TopStocksHandlerMock mock;
+    TopStocks topStocks(mock);
+    topStocks.EnableSuppression(true);
+
+    Add20Stocks(mock, topStocks);
+
+    mock.ExpectGainers({{
+        {1, 100}, {20, 0}, {19, 0}, {18, 0}, {17, 0}, {16, 0}, {15, 0}, {14, 0}, {13, 0}, {12, 0},
+    }});
+    mock.ExpectLosers({{
+        {2, 0}, {3, 0}, {4, 0}, {5, 0}, {6, 0}, {7, 0}, {8, 0}, {9, 0}, {10, 0}, {11, 0},
+    }});
+    topStocks.OnQuote(1, 20);
+
+    mock.ExpectGainersPersist();
+    mock.ExpectLosers({{
+        {2, -50}, {3, 0}, {4, 0}, {5, 0}, {6, 0}, {7, 0}, {8, 0}, {9, 0}, {10, 0}, {11, 0},
+    }});
+    topStocks.OnQuote(2, 10);
+
+    auto metrics = topStocks.Metrics();
+    assert(metrics.Gainers.SuppressedNotifications == 1 && !metrics.Gainers.SpuriousNotifications);
+    assert(!metrics.Losers.SuppressedNotifications && !metrics.Losers.SpuriousNotifications);
+}
+
+template <size_t K = TopSize, typename TComparator>
+TBasicTopList<K> MakeTop(std::vector<TQuote> aQuotes, TComparator aComparator)
+{
+    std::sort(aQuotes.begin(), aQuotes.end(),
+        [&aComparator](const auto& l, const auto& r)
+        {
+            return aComparator(std::make_pair(l.second, l.first), std::make_pair(r.second, r.first));
+        }
+    );
+
+    TBasicTopList<K> top {};
+    std::copy_n(aQuotes.cbegin(), std::min(top.size(), aQuotes.size()), top.begin());
+    return top;
+}
+
+void ShouldTrackSparseIds()
+{
+    TopStocksHandlerMock mock;
+    TopStocks topStocks(mock, 16);
+    topStocks.EnableSuppression(true);
+    topStocks.EnableTieNotifications(true);
+
+    std::vector<TQuote> quotes;
+    TTopList gainers {};
+    TTopList losers {};
+
+    // Only the changed tops are notified.
+    auto expect = [&]()
+    {
+        auto top = MakeTop(quotes, std::greater<>());
+        if (top != gainers)
+        {
+            mock.ExpectGainers(gainers = top);
+        }
+        else
+        {
+            mock.ExpectGainersPersist();
+        }
+
+        top = MakeTop(quotes, std::less<>());
+        if (top != losers)
+        {
+            mock.ExpectLosers(losers = top);
+        }
+        else
+        {
+            mock.ExpectLosersPersist();
+        }
+    };
+
+    for (int i = 1; i <= 30; ++i)
+    {
+        TId id = i % 2 ? i : 1000000000 + i * 7919;
+        quotes.emplace_back(id, 0);
+
+        expect();
+        topStocks.OnQuote(id, 10);
+    }
+
+    quotes[5].second = 100;
+    expect();
+    topStocks.OnQuote(quotes[5].first, 20);
+
+    quotes[8].second = -50;
+    expect();
+    topStocks.OnQuote(quotes[8].first, 5);
+}
+
+void ShouldNotifyOncePerBatch()
+{
+    TopStocksHandlerMock mock;
+    TopStocks topStocks(mock);
+
+    mock.ExpectGainers({{{42, 12.3}, {41, 0}}});
+    mock.ExpectLosers({{{41, 0}, {42, 12.3}}});
+    topStocks.OnQuotes({{{42, 100}, {41, 100}, {42, 112.3}}});
+}
+
+void ShouldNotifyFinalTopOfBatch()
+{
+    TopStocksHandlerMock mock;
+    TopStocks topStocks(mock);
+
+    Add20Stocks(mock, topStocks);
+
+    mock.ExpectGainersPersist();
+    mock.ExpectLosersPersist();
+    topStocks.OnQuotes({});
+
+    mock.ExpectGainers({{
+        {1, 100}, {20, 0}, {19, 0}, {18, 0}, {17, 0}, {16, 0}, {15, 0}, {14, 0}, {13, 0}, {12, 0},
+    }});
+    mock.ExpectLosers({{
+        {2, -50}, {3, 0}, {4, 0}, {5, 0}, {6, 0}, {7, 0}, {8, 0}, {9, 0}, {10, 0}, {11, 0},
+    }});
+    std::vector<Quote> quotes {{1, 5}, {2, 40}, {1, 20}, {2, 10}};
+    topStocks.OnQuotes(quotes);
+}
+
+void ShouldConflateNotifications()
+{
+    using namespace std::chrono_literals;
+
+    ManualClock clock;
+    TopStocksHandlerMock mock;
+    TopStocks topStocks(mock, QuoteStore::DefaultDenseLimit, clock);
+    topStocks.SetGainersConflation(10ms);
+
+    mock.ExpectGainers({{{42, 0}}});
+    mock.ExpectLosers({{{42, 0}}});
+    topStocks.OnQuote(42, 100);
+
+    clock.Advance(1ms);
+    mock.ExpectGainersPersist();
+    mock.ExpectLosers({{{42, 12.3}}});
+    topStocks.OnQuote(42, 112.3);
+
+    mock.ExpectGainersPersist();
+    mock.ExpectLosers({{{42, 20}}});
+    topStocks.OnQuote(42, 120);
+
+    clock.Advance(8ms);
+    mock.ExpectGainersPersist();
+    mock.ExpectLosersPersist();
+    topStocks.Poll();
+
+    clock.Advance(1ms);
+    mock.ExpectGainers({{{42, 20}}});
+    topStocks.Poll();
+
+    mock.ExpectGainersPersist();
+    mock.ExpectLosers({{{42, 30}}});
+    topStocks.OnQuote(42, 130);
+
+    mock.ExpectGainers({{{42, 30}}});
+    mock.ExpectLosersPersist();
+    topStocks.Flush();
+
+    mock.ExpectGainersPersist();
+    topStocks.Flush();
+}
+
+template <size_t K>
+struct BasicLastTopHandler : IBasicTopStocksHandler<K>
+{
+    using TTopList = TBasicTopList<K>;
+
+    void ProcessTopGainersChanged(const TTopList& aTop) override
+    {
+        mGainers = aTop;
+        ++mGainersCount;
+    }
+
+    void ProcessTopLosersChanged(const TTopList& aTop) override
+    {
+        mLosers = aTop;
+        ++mLosersCount;
+    }
+
+    TTopList mGainers {};
+    TTopList mLosers {};
+    size_t mGainersCount = 0;
+    size_t mLosersCount = 0;
+};
+
+using LastTopHandler = BasicLastTopHandler<TopSize>;
+
+void ShouldNotifyTiedEntries()
+{
+    LastTopHandler handler;
+    TopStocks topStocks(handler);
+    topStocks.EnableTieNotifications(true);
+
+    LastTopHandler defaultHandler;
+    TopStocks defaultTopStocks(defaultHandler);
+
+    // Ties are ordered by id, so every new stock at 0% enters the gainers top but not the losers one.
+    std::vector<TQuote> quotes;
+    for (int i = 1; i <= 20; ++i)
+    {
+        quotes.emplace_back(i, 0);
+        topStocks.OnQuote(i, i * 10);
+        defaultTopStocks.OnQuote(i, i * 10);
+
+        assert(handler.mGainers == MakeTop(quotes, std::greater<>()));
+        assert(handler.mGainersCount == static_cast<size_t>(i));
+        assert(handler.mLosers == MakeTop(quotes, std::less<>()));
+        assert(handler.mLosersCount == std::min<size_t>(i, TopSize));
+    }
+
+    // By default only the stocks entering a top which is not full are notified.
+    assert(defaultHandler.mGainersCount == TopSize && defaultHandler.mLosersCount == TopSize);
+}
+
+std::vector<Quote> MakeRandomQuotes(size_t aCount, int aStocks, unsigned aSeed)
+{
+    std::vector<Quote> quotes;
+    for (size_t i = 0; i < aCount; ++i)
+    {
+        aSeed = aSeed * 1103515245 + 12345;
+        int id = static_cast<int>(aSeed >> 8) % aStocks + 1;
+        aSeed = aSeed * 1103515245 + 12345;
+        quotes.push_back({id, static_cast<double>((aSeed >> 8) % 1000 + 1)});
+    }
+    return quotes;
+}
+
+void ShouldMergeShardTops()
+{
+    auto quotes = MakeRandomQuotes(20000, 300, 42);
+
+    LastTopHandler expected;
+    TopStocks topStocks(expected);
+    for (const auto& quote : quotes)
+    {
+        topStocks.OnQuote(quote.StockId, quote.Price);
+    }
+
+    LastTopHandler actual;
+    ShardedTopStocks shardedTopStocks(actual, 3);
+    // The shards keep most of the stocks beyond their dense ids.
+    LastTopHandler sparseActual;
+    ShardedTopStocks sparseShardedTopStocks(sparseActual, 4, 64);
+    for (size_t i = 0; i < quotes.size(); i += 1000)
+    {
+        shardedTopStocks.OnQuotes({quotes.data() + i, 1000});
+        sparseShardedTopStocks.OnQuotes({quotes.data() + i, 1000});
+    }
+    shardedTopStocks.OnQuote(quotes.front().StockId, quotes.front().Price);
+    sparseShardedTopStocks.OnQuote(quotes.front().StockId, quotes.front().Price);
+    topStocks.OnQuote(quotes.front().StockId, quotes.front().Price);
+    shardedTopStocks.Wait();
+    sparseShardedTopStocks.Wait();
+
+    assert(expected.mGainers == actual.mGainers);
+    assert(expected.mLosers == actual.mLosers);
+    assert(expected.mGainers == sparseActual.mGainers);
+    assert(expected.mLosers == sparseActual.mLosers);
+}
+
+void ShouldDropOldestQuotes()
+{
+    QuoteQueue queue(4, Backpressure::DropOldest);
+    for (int i = 1; i <= 6; ++i)
+    {
+        queue.Push({i, i * 10.});
+    }
+
+    auto stats = queue.Stats();
+    assert(stats.Depth == 4);
+    assert(stats.Pushed == 6);
+    assert(stats.Dropped == 2);
+
+    Quote quotes[8];
+    assert(queue.Pop(quotes, 8) == 4);
+    for (int i = 0; i < 4; ++i)
+    {
+        assert(quotes[i].StockId == i + 3);
+        assert(quotes[i].Price == (i + 3) * 10.);
+    }
+    assert(queue.Stats().Depth == 0);
+}
+
+void ShouldConflateQueuedQuotes()
+{
+    QuoteQueue queue(4, Backpressure::ConflatePerId, 100);
+    queue.Push({1, 10});
+    queue.Push({2, 20});
+    queue.Push({1, 11});
+    queue.Push({1, 12});
+    queue.Push({200, 1});
+
+    auto stats = queue.Stats();
+    assert(stats.Depth == 3);
+    assert(stats.Conflated == 2);
+
+    Quote quotes[8];
+    assert(queue.Pop(quotes, 2) == 2);
+    assert(quotes[0].StockId == 1 && quotes[0].Price == 12);
+    assert(quotes[1].StockId == 2 && quotes[1].Price == 20);
+
+    queue.Push({1, 13});
+    assert(queue.Pop(quotes, 8) == 2);
+    assert(quotes[0].StockId == 200 && quotes[0].Price == 1);
+    assert(quotes[1].StockId == 1 && quotes[1].Price == 13);
+    assert(queue.Stats().Conflated == 2);
+}
+
+void ShouldProcessQueuedQuotes()
+{
+    using namespace std::chrono_literals;
+
+    auto quotes = MakeRandomQuotes(20000, 300, 7);
+
+    LastTopHandler expected;
+    TopStocks topStocks(expected);
+    topStocks.OnQuotes(quotes);
+
+    LastTopHandler actual;
+    TopStocks engine(actual);
+    {
+        QueuedTopStocks queuedTopStocks(engine, 64);
+        for (size_t i = 0; i < quotes.size(); ++i)
+        {
+            if (i == quotes.size() / 2)
+            {
+                // The idle engine thread goes to sleep and is woken by the next quote.
+                queuedTopStocks.Wait();
+                std::this_thread::sleep_for(10ms);
+            }
+            queuedTopStocks.OnQuote(quotes[i].StockId, quotes[i].Price);
+        }
+        queuedTopStocks.Wait();
+
+        auto stats = queuedTopStocks.Stats();
+        assert(stats.Depth == 0);
+        assert(stats.Pushed == quotes.size());
+        assert(!stats.Dropped && !stats.Conflated);
+    }
+
+    assert(expected.mGainers == actual.mGainers);
+    assert(expected.mLosers == actual.mLosers);
+}
+
+void ShouldRestoreFromOrderIndex()
+{
+    auto quotes = MakeRandomQuotes(20000, 300, 13);
+
+    LastTopHandler expected;
+    TopStocks topStocks(expected);
+
+    LastTopHandler actual;
+    TopStocks indexedTopStocks(actual);
+
+    for (size_t i = 0; i < quotes.size(); ++i)
+    {
+        if (i == 100)
+        {
+            indexedTopStocks.EnableOrderIndex(true);
+        }
+
+        topStocks.OnQuote(quotes[i].StockId, quotes[i].Price);
+        indexedTopStocks.OnQuote(quotes[i].StockId, quotes[i].Price);
+
+        assert(expected.mGainers == actual.mGainers);
+        assert(expected.mLosers == actual.mLosers);
+    }
+
+    assert(expected.mGainersCount == actual.mGainersCount);
+    assert(expected.mLosersCount == actual.mLosersCount);
+}
+
+void ShouldAdaptCandidateCapacity()
+{
+    LastTopHandler expected;
+    TopStocks topStocks(expected);
+
+    LastTopHandler actual;
+    TopStocks adaptiveTopStocks(actual);
+    adaptiveTopStocks.SetAdaptiveCapacity({11, TopMaxCapacity, 0.001, 500});
+
+    auto onQuote = [&](TId aStockId, double aPrice)
+    {
+        topStocks.OnQuote(aStockId, aPrice);
+        adaptiveTopStocks.OnQuote(aStockId, aPrice);
+
+        assert(expected.mGainers == actual.mGainers);
+        assert(expected.mLosers == actual.mLosers);
+    };
+
+    for (int i = 1; i <= 100; ++i)
+    {
+        onQuote(i, 100);
+    }
+    for (int i = 1; i <= 20; ++i)
+    {
+        onQuote(i, 150 + i);
+        onQuote(20 + i, 50 - i);
+    }
+
+    // Quiet: the candidates are never drained, the capacity shrinks to the minimum.
+    for (int i = 0; i < 5000; ++i)
+    {
+        onQuote(41 + i % 60, 99 + i % 3);
+    }
+
+    auto quiet = adaptiveTopStocks.GainersStats();
+    assert(quiet.Capacity == 11 && quiet.Shrinks && !quiet.Grows && !quiet.Restores);
+    assert(adaptiveTopStocks.LosersStats().Capacity == 11);
+
+    // Volatile: the restores make the capacity grow back.
+    for (const auto& quote : MakeRandomQuotes(20000, 100, 17))
+    {
+        onQuote(quote.StockId, quote.Price);
+    }
+
+    auto volatileStats = adaptiveTopStocks.GainersStats();
+    assert(volatileStats.Grows && volatileStats.Restores);
+    assert(volatileStats.Capacity > 11);
+    assert(volatileStats.Quotes == quiet.Quotes + 20000);
+}
+
+// Every callback takes the given time of the clock.
+struct RepeatCountingHandler : LastTopHandler
+{
+    RepeatCountingHandler(ManualClock& aClock, TDuration aCallbackLatency)
+        : mClock(aClock)
+        , mCallbackLatency(aCallbackLatency)
+    {
+
+    }
+
+    void ProcessTopGainersChanged(const TTopList& aTop) override
+    {
+        mGainersRepeats += aTop == mGainers;
+        LastTopHandler::ProcessTopGainersChanged(aTop);
+        mClock.Advance(mCallbackLatency);
+    }
+
+    void ProcessTopLosersChanged(const TTopList& aTop) override
+    {
+        mLosersRepeats += aTop == mLosers;
+        LastTopHandler::ProcessTopLosersChanged(aTop);
+        mClock.Advance(mCallbackLatency);
+    }
+
+    ManualClock& mClock;
+    TDuration mCallbackLatency;
+    size_t mGainersRepeats = 0;
+    size_t mLosersRepeats = 0;
+};
+
+void ShouldReportMetrics()
+{
+    ManualClock clock;
+    const TDuration callbackLatency(300);
+    RepeatCountingHandler handler(clock, callbackLatency);
+    TopStocks topStocks(handler, QuoteStore::DefaultDenseLimit, clock);
+    topStocks.EnableLatencyMetrics(true);
+
+    topStocks.OnQuote(0, 100);
+    topStocks.OnQuote(-1, 100);
+    topStocks.OnQuote(1, 0);
+
+    auto quotes = MakeRandomQuotes(20000, 300, 7);
+    for (size_t i = 0; i < 10000; ++i)
+    {
+        topStocks.OnQuote(quotes[i].StockId, quotes[i].Price);
+    }
+    auto quoteCallbacks = handler.mGainersCount + handler.mLosersCount;
+    topStocks.OnQuotes({quotes.data() + 10000, 10000});
+    auto batchCallbacks = handler.mGainersCount + handler.mLosersCount - quoteCallbacks;
+
+    auto metrics = topStocks.Metrics();
+    assert(metrics.Ticks == 20003);
+    assert(metrics.IgnoredTicks == 3);
+
+    assert(metrics.Gainers.Restores && metrics.Gainers.Restores == topStocks.GainersStats().Restores);
+    assert(metrics.Losers.Restores == topStocks.LosersStats().Restores);
+    assert(metrics.Gainers.Notifications == handler.mGainersCount);
+    assert(metrics.Losers.Notifications == handler.mLosersCount);
+    assert(handler.mGainersRepeats && metrics.Gainers.SpuriousNotifications == handler.mGainersRepeats);
+    assert(handler.mLosersRepeats && metrics.Losers.SpuriousNotifications == handler.mLosersRepeats);
+    assert(!metrics.Gainers.SuppressedNotifications && !metrics.Losers.SuppressedNotifications);
+
+    assert(metrics.QuoteLatency.Count == 10003);
+    assert(metrics.QuoteLatency.Total == callbackLatency * quoteCallbacks);
+    assert(metrics.QuoteLatency.Max == 2 * callbackLatency);
+    assert(metrics.BatchLatency.Count == 1);
+    assert(batchCallbacks && metrics.BatchLatency.Total == callbackLatency * batchCallbacks);
+
+    // 300 ns fall into the bucket of [256, 512) ns.
+    for (const auto& callbacks : {metrics.Gainers.CallbackLatency, metrics.Losers.CallbackLatency})
+    {
+        assert(callbacks.Counts[8] == callbacks.Count && callbacks.Max == callbackLatency);
+        assert(callbacks.Percentile(0.5) == callbackLatency);
+    }
+    assert(metrics.Gainers.CallbackLatency.Count == handler.mGainersCount);
+    assert(metrics.Losers.CallbackLatency.Count == handler.mLosersCount);
+
+    LatencyHistogram histogram;
+    for (int i = 0; i < 98; ++i)
+    {
+        histogram.Record(TDuration(100));
+    }
+    histogram.Record(TDuration(1000));
+    histogram.Record(TDuration(5000));
+
+    auto latency = histogram.Snapshot();
+    assert(latency.Count == 100);
+    assert(latency.Total == TDuration(98 * 100 + 1000 + 5000));
+    assert(latency.Max == TDuration(5000));
+    assert(latency.Percentile(0.5) == TDuration(128));
+    assert(latency.Percentile(0.98) == TDuration(1024));
+    assert(latency.Percentile(1) == TDuration(5000));
+}
+
+// The files of the tests are kept in the temporary directory.
+std::string TempPath(const char* aName)
+{
+    return (std::filesystem::temp_directory_path() / aName).string();
+}
+
+std::vector<char> ReadFile(const std::string& aPath)
+{
+    std::vector<char> bytes;
+    if (std::FILE* file = std::fopen(aPath.c_str(), "rb"))
+    {
+        char buffer[4096];
+        size_t read = 0;
+        while ((read = std::fread(buffer, 1, sizeof(buffer), file)) > 0)
+        {
+            bytes.insert(bytes.end(), buffer, buffer + read);
+        }
+        std::fclose(file);
+    }
+    return bytes;
+}
+
+void WriteFile(const std::string& aPath, const std::vector<char>& aBytes)
+{
+    std::FILE* file = std::fopen(aPath.c_str(), "wb");
+    assert(file);
+    std::fwrite(aBytes.data(), 1, aBytes.size(), file);
+    std::fclose(file);
+}
+
+void ShouldRecordTickJournal()
+{
+    const auto path = TempPath("ShouldRecordTickJournal.bin");
+    auto quotes = MakeRandomQuotes(1000, 100, 3);
+
+    LastTopHandler expected;
+    TopStocks topStocks(expected);
+
+    LastTopHandler actual;
+    {
+        ManualClock clock;
+        TopStocks recordedTopStocks(actual);
+        RecordingTopStocks recorder(recordedTopStocks, path, 256, clock);
+
+        for (size_t i = 0; i < 900; ++i)
+        {
+            clock.Advance(TDuration(10));
+            recorder.OnQuote(quotes[i].StockId, quotes[i].Price);
+            topStocks.OnQuote(quotes[i].StockId, quotes[i].Price);
+        }
+
+        clock.Advance(TDuration(10));
+        recorder.OnQuotes({quotes.data() + 900, 100});
+        topStocks.OnQuotes({quotes.data() + 900, 100});
+
+        auto stats = recorder.Stats();
+        assert(stats.Recorded == quotes.size() && !stats.Dropped);
+        assert(!stats.IsFailed);
+    }
+
+    assert(expected.mGainers == actual.mGainers);
+    assert(expected.mLosers == actual.mLosers);
+
+    MappedJournal journal(path);
+    auto records = journal.Records();
+
+    // All the ticks fit the buffers even if the writer has not written any of them yet.
+    assert(records.size() == quotes.size());
+    for (size_t i = 0; i < records.size(); ++i)
+    {
+        assert(records[i].StockId == quotes[i].StockId && records[i].Price == quotes[i].Price);
+        assert(records[i].Timestamp == static_cast<std::int64_t>(std::min<size_t>(i, 900) + 1) * 10);
+    }
+
+    std::remove(path.c_str());
+}
+
+void ShouldRejectInvalidJournal()
+{
+    const auto path = TempPath("ShouldRejectInvalidJournal.bin");
+
+    auto isRejected = [](const std::string& aPath)
+    {
+        try
+        {
+            MappedJournal journal(aPath);
+        }
+        catch (const std::runtime_error&)
+        {
+            return true;
+        }
+        return false;
+    };
+
+    assert(isRejected(path));
+
+    JournalHeader header {};
+    std::copy_n(JournalHeader::Signature, sizeof(header.Magic), header.Magic);
+    header.Version = JournalHeader::CurrentVersion;
+    header.RecordSize = sizeof(JournalRecord);
+    const auto* bytes = reinterpret_cast<const char*>(&header);
+
+    WriteFile(path, {bytes, bytes + sizeof(header) - 1});
+    assert(isRejected(path));
+
+    WriteFile(path, {bytes, bytes + sizeof(header)});
+    assert(!isRejected(path));
+
+    header.Magic[0] = 'X';
+    WriteFile(path, {bytes, bytes + sizeof(header)});
+    assert(isRejected(path));
+
+    header.Magic[0] = JournalHeader::Signature[0];
+    header.Version = JournalHeader::CurrentVersion + 1;
+    WriteFile(path, {bytes, bytes + sizeof(header)});
+    assert(isRejected(path));
+
+    header.Version = JournalHeader::CurrentVersion;
+    header.RecordSize = sizeof(JournalRecord) + 8;
+    WriteFile(path, {bytes, bytes + sizeof(header)});
+    assert(isRejected(path));
+
+    std::remove(path.c_str());
+}
+
+void ShouldCompareTopListLogs()
+{
+    const auto path = TempPath("ShouldCompareTopListLogs.log");
+    auto quotes = MakeRandomQuotes(2000, 100, 17);
+
+    std::uint64_t notifications = 0;
+    {
+        replay::TopListLog log;
+        log.Record(path);
+        TopStocks topStocks(log);
+        for (size_t i = 0; i < quotes.size(); ++i)
+        {
+            log.SetTick(i);
+            topStocks.OnQuote(quotes[i].StockId, quotes[i].Price);
+        }
+        assert(!log.Finish());
+        notifications = log.Notifications();
+    }
+    assert(notifications);
+
+    {
+        replay::TopListLog log;
+        log.Expect(path);
+        TopStocks topStocks(log);
+        for (const auto& quote : quotes)
+        {
+            topStocks.OnQuote(quote.StockId, quote.Price);
+        }
+        assert(log.Notifications() == notifications);
+        assert(!log.Finish());
+    }
+
+    // The first mismatch is reported to the standard error.
+    auto* errors = std::cerr.rdbuf(nullptr);
+    {
+        replay::TopListLog log;
+        log.Expect(path);
+        TopStocks topStocks(log);
+        quotes[quotes.size() / 2].Price *= 2;
+        for (const auto& quote : quotes)
+        {
+            topStocks.OnQuote(quote.StockId, quote.Price);
+        }
+        assert(log.Finish());
+    }
+    {
+        replay::TopListLog log;
+        log.Expect(path);
+        TopStocks topStocks(log);
+        for (size_t i = 0; i < quotes.size() / 2; ++i)
+        {
+            topStocks.OnQuote(quotes[i].StockId, quotes[i].Price);
+        }
+        // The lists expected after the last quote are missing.
+        assert(log.Finish());
+    }
+    std::cerr.rdbuf(errors);
+    std::cerr.clear();
+
+    std::remove(path.c_str());
+}
+
+void ShouldWarmRestartFromSnapshot()
+{
+    const auto path = TempPath("ShouldWarmRestartFromSnapshot.bin");
+    auto quotes = MakeRandomQuotes(20000, 300, 11);
+
+    LastTopHandler expected;
+    TopStocks topStocks(expected);
+    topStocks.OnQuote(5000000, 1);
+    for (size_t i = 0; i < 10000; ++i)
+    {
+        topStocks.OnQuote(quotes[i].StockId, quotes[i].Price);
+    }
+    topStocks.OnQuote(5000000, 2000);
+    assert(topStocks.SaveSnapshot(path));
+
+    BasicLastTopHandler<3> top3;
+    BasicTopStocks<3> topStocks3(top3);
+    assert(!topStocks3.LoadSnapshot(path));
+    assert(!top3.mGainersCount && !top3.mLosersCount);
+
+    LastTopHandler actual;
+    TopStocks restoredTopStocks(actual);
+    restoredTopStocks.EnableOrderIndex(true);
+    restoredTopStocks.OnQuote(42, 100);
+    assert(restoredTopStocks.LoadSnapshot(path));
+    std::remove(path.c_str());
+
+    assert(actual.mGainersCount == 2 && actual.mLosersCount == 2);
+    assert(expected.mGainers == actual.mGainers);
+    assert(expected.mLosers == actual.mLosers);
+    assert(actual.mGainers[0].first == 5000000);
+
+    for (size_t i = 10000; i < quotes.size(); ++i)
+    {
+        topStocks.OnQuote(quotes[i].StockId, quotes[i].Price);
+        restoredTopStocks.OnQuote(quotes[i].StockId, quotes[i].Price);
+
+        assert(expected.mGainers == actual.mGainers);
+        assert(expected.mLosers == actual.mLosers);
+    }
+}
+
+void ShouldRejectCorruptSnapshot()
+{
+    const auto path = TempPath("ShouldRejectCorruptSnapshot.bin");
+    const auto corruptPath = TempPath("ShouldRejectCorruptSnapshot.corrupt.bin");
+
+    LastTopHandler handler;
+    TopStocks topStocks(handler);
+    topStocks.EnableOrderIndex(true);
+    topStocks.OnQuote(1, 10);
+    topStocks.OnQuote(2, 10);
+    topStocks.OnQuote(1, 11);
+    topStocks.OnQuote(2, 9);
+    assert(topStocks.SaveSnapshot(path));
+    const auto bytes = ReadFile(path);
+    std::remove(path.c_str());
+
+    const size_t stocks = 2;
+    const size_t idsOffset = sizeof(SnapshotHeader);
+    const size_t statesOffset = idsOffset + stocks * (sizeof(TId) + sizeof(TBase) + sizeof(TChange));
+    // The limit follows the two thresholds in a candidate set state.
+    const size_t limitOffset = statesOffset + 2 * sizeof(TChange);
+
+    std::vector<std::vector<char>> corrupts;
+    corrupts.emplace_back(bytes.begin(), bytes.end() - 1);
+    corrupts.emplace_back(bytes.begin(), bytes.begin() + statesOffset);
+    corrupts.push_back(bytes);
+    ++corrupts.back()[offsetof(SnapshotHeader, Stocks)];
+    corrupts.push_back(bytes);
+    std::copy_n(&bytes[idsOffset], sizeof(TId), &corrupts.back()[idsOffset + sizeof(TId)]);
+    corrupts.push_back(bytes);
+    std::fill_n(&corrupts.back()[idsOffset], sizeof(TId), 0);
+    corrupts.push_back(bytes);
+    std::fill_n(&corrupts.back()[limitOffset], sizeof(std::uint64_t), 0);
+    corrupts.push_back(bytes);
+    std::fill_n(&corrupts.back()[limitOffset], sizeof(std::uint64_t), char(0xff));
+
+    LastTopHandler restoredHandler;
+    TopStocks restoredTopStocks(restoredHandler);
+    restoredTopStocks.EnableOrderIndex(true);
+    restoredTopStocks.OnQuote(3, 10);
+    restoredTopStocks.OnQuote(3, 12);
+    const auto top = restoredTopStocks.Top(TopSize);
+    assert(top.size() == 1 && top[0] == TQuote(3, 20));
+    const auto gainers = restoredHandler.mGainers;
+    const auto losers = restoredHandler.mLosers;
+    const auto gainersCount = restoredHandler.mGainersCount;
+
+    for (const auto& corrupt : corrupts)
+    {
+        WriteFile(corruptPath, corrupt);
+        assert(!restoredTopStocks.LoadSnapshot(corruptPath));
+        assert(restoredTopStocks.Top(TopSize) == top);
+        assert(restoredHandler.mGainers == gainers && restoredHandler.mLosers == losers);
+        assert(restoredHandler.mGainersCount == gainersCount);
+    }
+
+    WriteFile(corruptPath, bytes);
+    assert(restoredTopStocks.LoadSnapshot(corruptPath));
+    std::remove(corruptPath.c_str());
+    assert(restoredTopStocks.Top(TopSize) == topStocks.Top(TopSize));
+    assert(restoredHandler.mGainers == handler.mGainers);
+    assert(restoredHandler.mLosers == handler.mLosers);
+}
+
+struct DeltaHandler : LastTopHandler
+{
+    void ProcessTopGainersDelta(const TTopList& aTop, Span<const TopChange> aChanges) override
+    {
+        mGainers = Apply(mGainers, aChanges);
+        assert(mGainers == aTop);
+        ++mGainersCount;
+    }
+
+    void ProcessTopLosersDelta(const TTopList& aTop, Span<const TopChange> aChanges) override
+    {
+        mLosers = Apply(mLosers, aChanges);
+        assert(mLosers == aTop);
+        ++mLosersCount;
+    }
+
+    static TTopList Apply(const TTopList& aTop, Span<const TopChange> aChanges)
+    {
+        TTopList top {};
+        for (size_t i = 0; i < aTop.size(); ++i)
+        {
+            bool isChanged = std::any_of(aChanges.begin(), aChanges.end(),
+                [&aTop, i](const auto& e) { return e.StockId == aTop[i].first; });
+            if (!isChanged)
+            {
+                top[i] = aTop[i];
+            }
+        }
+
+        for (const auto& change : aChanges)
+        {
+            if (change.Kind != TopChangeKind::Left)
+            {
+                top[change.Position] = {change.StockId, change.Change};
+            }
+        }
+
+        return top;
+    }
+};
+
+void ShouldNotifyDeltas()
+{
+    auto quotes = MakeRandomQuotes(20000, 300, 23);
+
+    LastTopHandler expected;
+    TopStocks topStocks(expected);
+
+    DeltaHandler actual;
+    TopStocks deltaTopStocks(actual);
+    deltaTopStocks.EnableDeltas(true);
+
+    for (const auto& quote : quotes)
+    {
+        topStocks.OnQuote(quote.StockId, quote.Price);
+        deltaTopStocks.OnQuote(quote.StockId, quote.Price);
+
+        assert(expected.mGainers == actual.mGainers);
+        assert(expected.mLosers == actual.mLosers);
+    }
+    assert(expected.mGainersCount == actual.mGainersCount);
+    assert(expected.mLosersCount == actual.mLosersCount);
+
+    // Only the changed positions are reported.
+    struct : DeltaHandler
+    {
+        void ProcessTopGainersDelta(const TTopList& aTop, Span<const TopChange> aChanges) override
+        {
+            mChanges.assign(aChanges.begin(), aChanges.end());
+            DeltaHandler::ProcessTopGainersDelta(aTop, aChanges);
+        }
+
+        std::vector<TopChange> mChanges;
+    } handler;
+
+    TopStocks smallTopStocks(handler);
+    smallTopStocks.EnableDeltas(true);
+    for (int i = 1; i <= 12; ++i)
+    {
+        smallTopStocks.OnQuote(i, 100);
+        smallTopStocks.OnQuote(i, 100 + i);
+    }
+
+    smallTopStocks.OnQuote(1, 103.5);
+    assert(handler.mChanges.size() == 2);
+    assert(handler.mChanges[0].Kind == TopChangeKind::Left && handler.mChanges[0].StockId == 3);
+    assert(handler.mChanges[1].Kind == TopChangeKind::Entered && handler.mChanges[1].StockId == 1);
+    assert(handler.mChanges[1].Position == 9 && handler.mChanges[1].Change == (103.5 - 100) / 100 * 100);
+
+    smallTopStocks.OnQuote(4, 111.5);
+    assert(handler.mChanges.size() == 8);
+    assert(handler.mChanges[0].Kind == TopChangeKind::Moved && handler.mChanges[0].StockId == 4);
+    assert(handler.mChanges[0].PreviousPosition == 8 && handler.mChanges[0].Position == 1);
+
+    smallTopStocks.OnQuote(12, 115);
+    assert(handler.mChanges.size() == 1 && handler.mChanges[0].Kind == TopChangeKind::Updated);
+}
+
+void ShouldHandOffLatestTop()
+{
+    display::TripleBuffer<TTopList> buffer;
+    const int count = 100000;
+
+    std::thread writer(
+        [&buffer]
+        {
+            for (int i = 1; i <= count; ++i)
+            {
+                TTopList top;
+                top.fill({i, i});
+                buffer.Publish(top);
+            }
+        }
+    );
+
+    int last = 0;
+    while (last != count)
+    {
+        if (buffer.Update())
+        {
+            const auto& top = buffer.Latest();
+            assert(top.front().first > last);
+            assert(std::all_of(top.begin(), top.end(), [&top](const auto& e) { return e == top.front(); }));
+            last = top.front().first;
+        }
+    }
+    writer.join();
+
+    assert(!buffer.Update());
+}
+
+void ShouldRenderRows()
+{
+    using namespace std::chrono_literals;
+
+    std::FILE* output = std::tmpfile();
+    assert(output);
+    auto written = [output]()
+    {
+        std::fseek(output, 0, SEEK_END);
+        return static_cast<size_t>(std::ftell(output));
+    };
+
+    ManualClock clock;
+    display::TerminalRenderer renderer(3, 100ms, clock, fileno(output));
+    const auto& frame = renderer.Frame();
+    auto hasRow = [&frame](const std::string& aRow)
+    {
+        return std::search(frame.begin(), frame.end(), aRow.begin(), aRow.end()) != frame.end();
+    };
+    const std::string lineEnd = "\x1b[K\n";
+
+    // The fields are right aligned, too long changes are truncated and the ones too long to format are starred.
+    std::vector<TQuote> gainers {{5, 12.5}, {2147483647, 1e12}, {7, 1e40}};
+    renderer.SetTop(display::TerminalRenderer::Gainers, gainers);
+    renderer.SetRow(display::TerminalRenderer::Losers, 0, 123, -3);
+    assert(hasRow("#1  " + std::string(11, ' ') + "5" + std::string(7, ' ') + "12.500000" + lineEnd));
+    assert(hasRow("#2  " + std::string(2, ' ') + "2147483647" + std::string(1, ' ') + "1000000000000.0" + lineEnd));
+    assert(hasRow("#3  " + std::string(11, ' ') + "7" + std::string(1, ' ') + std::string(15, '*') + lineEnd));
+    assert(hasRow("#1  " + std::string(9, ' ') + "123" + std::string(7, ' ') + "-3.000000" + lineEnd));
+
+    renderer.Poll();
+    assert(written() == frame.size());
+
+    // A frame within the interval is held back, the screen is cleared by the first frame only.
+    renderer.SetTop(display::TerminalRenderer::Gainers, Span<const TQuote>(gainers.data(), 1));
+    clock.Advance(50ms);
+    renderer.Poll();
+    assert(written() == frame.size());
+
+    clock.Advance(50ms);
+    renderer.Poll();
+    assert(written() == 2 * frame.size() - 4);
+
+    renderer.ClearRow(display::TerminalRenderer::Gainers, 1);
+    assert(hasRow(std::string(32, ' ') + lineEnd));
+    clock.Advance(100ms);
+    renderer.Poll();
+    renderer.Poll();
+    assert(written() == 3 * frame.size() - 8);
+
+    std::fclose(output);
+}
+
+void ShouldKeepCandidatesOrderedWithTies()
+{
+    using TElement = std::pair<TChange, TId>;
+
+    // Ties are ordered by id in the same direction as the changes.
+    CandidateBuffer<std::greater, 4> gainers;
+    assert(!gainers.Insert(1, 10) && !gainers.Insert(2, 5) && !gainers.Insert(1, 20) && !gainers.Insert(1, 15));
+    assert(gainers.IsFull());
+    assert(gainers[0] == TElement(2, 5) && gainers[1] == TElement(1, 20) && gainers[2] == TElement(1, 15));
+    assert(gainers.Back() == TElement(1, 10));
+
+    // A tie at capacity enters only if ordered before the worst element.
+    assert(gainers.Position(1, 12) == 3);
+    assert(gainers.Insert(1, 12));
+    assert(gainers.Size() == 4 && gainers.Back() == TElement(1, 12));
+    assert(gainers.Position(1, 11) == 4);
+    assert(gainers.Insert(1, 11));
+    assert(gainers.Back() == TElement(1, 12));
+    assert(gainers.Insert(1, 30));
+    assert(gainers[1] == TElement(1, 30) && gainers.Back() == TElement(1, 15));
+
+    assert(!gainers.Erase(1, 12));
+    assert(!gainers.Erase(2, 20));
+    assert(gainers.Erase(1, 20));
+    assert(gainers.Size() == 3 && gainers[2] == TElement(1, 15));
+    assert(gainers.Position(1, 20) == 2 && gainers.Position(1, 15) == 2);
+
+    gainers.SetLimit(2);
+    assert(gainers.IsFull() && gainers.Back() == TElement(1, 30));
+
+    CandidateBuffer<std::less, 2> losers;
+    assert(!losers.Insert(0, 3) && !losers.Insert(0, 1));
+    assert(losers.Insert(0, 2));
+    assert(losers[0] == TElement(0, 1) && losers[1] == TElement(0, 2));
+    assert(losers.Erase(0, 1) && losers.Size() == 1 && losers[0] == TElement(0, 2));
+}
+
+template <typename TCandidates>
+bool AreEqual(const TCandidates& aLeft, const TCandidates& aRight)
+{
+    return aLeft.Size() == aRight.Size()
+        && std::equal(aLeft.Ids(), aLeft.Ids() + aLeft.Size(), aRight.Ids())
+        && std::equal(aLeft.Changes(), aLeft.Changes() + aLeft.Size(), aRight.Changes());
+}
+
+void ShouldRankRollingWindows()
+{
+    using namespace std::chrono_literals;
+
+    ManualClock clock;
+    LastTopHandler shortWindow, longWindow;
+    WindowedTopStocks topStocks({{2s, shortWindow}, {5s, longWindow}}, 1s, QuoteStore::DefaultDenseLimit, clock);
+
+    // The reference keeps the whole history, the base of a window is the last price of the bucket which has
+    // left it, or the first price.
+    std::vector<std::vector<std::pair<std::int64_t, double>>> history(31);
+    auto expect = [&](const LastTopHandler& aHandler, std::int64_t aBuckets)
+    {
+        auto now = clock.Now().time_since_epoch() / 1s;
+        std::vector<TQuote> changes;
+        for (int id = 1; id < static_cast<int>(history.size()); ++id)
+        {
+            if (history[id].empty())
+            {
+                continue;
+            }
+
+            double base = history[id].front().second;
+            for (const auto& tick : history[id])
+            {
+                if (tick.first <= now - aBuckets)
+                {
+                    base = tick.second;
+                }
+            }
+            changes.emplace_back(id, (history[id].back().second - base) / base * 100);
+        }
+
+        assert(aHandler.mGainers == MakeTop(changes, std::greater<>()));
+        assert(aHandler.mLosers == MakeTop(changes, std::less<>()));
+    };
+
+    auto quotes = MakeRandomQuotes(3000, 30, 7);
+    unsigned seed = 11;
+    for (size_t i = 0; i < quotes.size(); ++i)
+    {
+        seed = seed * 1103515245 + 12345;
+        clock.Advance(std::chrono::milliseconds((seed >> 8) % 300));
+        if (i % 500 == 499)
+        {
+            // A pause longer than the windows.
+            clock.Advance(7s);
+            topStocks.Poll();
+            expect(shortWindow, 2);
+            expect(longWindow, 5);
+        }
+
+        const auto& quote = quotes[i];
+        history[quote.StockId].emplace_back(clock.Now().time_since_epoch() / 1s, quote.Price);
+        topStocks.OnQuote(quote.StockId, quote.Price);
+
+        expect(shortWindow, 2);
+        expect(longWindow, 5);
+    }
+
+    // Without quotes the windows age on poll.
+    clock.Advance(1s);
+    topStocks.Poll();
+    expect(shortWindow, 2);
+    expect(longWindow, 5);
+}
+
+void ShouldComputeBasisPointChanges()
+{
+    LastTopHandler percent;
+    TopStocks percentTopStocks(percent);
+    LastTopHandler basisPoints;
+    BasicTopStocks<TopSize, TopMaxCapacity, BasisPointChange<>> basisPointTopStocks(basisPoints);
+
+    auto quote = [&](TId aStockId, double aPrice)
+    {
+        percentTopStocks.OnQuote(aStockId, aPrice);
+        basisPointTopStocks.OnQuote(aStockId, aPrice);
+    };
+
+    for (TId id = 1; id <= 12; ++id)
+    {
+        quote(id, id);
+    }
+    quote(1, 1.1);
+    quote(3, 3.3);
+    quote(2, 0.4);
+    quote(6, 4);
+
+    // 3 -> 3.3 is not exactly 10% in double, so the percent top does not see the tie.
+    assert(percent.mGainers[0].first == 1 && percent.mGainers[1].first == 3);
+    assert(percent.mGainers[1].second != 10);
+
+    // Exact basis points tie and are ordered by id, the changes are rounded to the nearest basis point.
+    assert(basisPoints.mGainers[0] == TQuote(3, 1000));
+    assert(basisPoints.mGainers[1] == TQuote(1, 1000));
+    assert(basisPoints.mLosers[0] == TQuote(2, -8000));
+    assert(basisPoints.mLosers[1] == TQuote(6, -3333));
+}
+
+// A handler without virtual methods.
+struct StaticHandler
+{
+    void ProcessTopGainersChanged(const TTopList& aTop)
+    {
+        mGainers = aTop;
+    }
+
+    void ProcessTopLosersChanged(const TTopList& aTop)
+    {
+        mLosers = aTop;
+    }
+
+    void ProcessTopGainersDelta(const TTopList& aTop, Span<const TopChange> aChanges)
+    {
+        mGainers = aTop;
+        mDeltas += aChanges.size();
+    }
+
+    void ProcessTopLosersDelta(const TTopList& aTop, Span<const TopChange> aChanges)
+    {
+        mLosers = aTop;
+        mDeltas += aChanges.size();
+    }
+
+    TTopList mGainers {};
+    TTopList mLosers {};
+    size_t mDeltas = 0;
+};
+
+void ShouldDispatchStatically()
+{
+    auto quotes = MakeRandomQuotes(5000, 100, 3);
+
+    LastTopHandler expected;
+    TopStocks topStocks(expected);
+    StaticHandler actual;
+    StaticTopStocks<StaticHandler> staticTopStocks(actual);
+
+    for (size_t i = 0; i < quotes.size(); ++i)
+    {
+        if (i == quotes.size() / 2)
+        {
+            staticTopStocks.EnableDeltas(true);
+        }
+
+        topStocks.OnQuote(quotes[i].StockId, quotes[i].Price);
+        staticTopStocks.OnQuote(quotes[i].StockId, quotes[i].Price);
+
+        assert(expected.mGainers == actual.mGainers);
+        assert(expected.mLosers == actual.mLosers);
+    }
+    assert(actual.mDeltas);
+}
+
+struct LastTopSubscriber : ITopSubscriber
+{
+    void ProcessTopGainersChanged(Span<const TQuote> aTop) override
+    {
+        mGainers.assign(aTop.begin(), aTop.end());
+        ++mGainersCount;
+    }
+
+    void ProcessTopLosersChanged(Span<const TQuote> aTop) override
+    {
+        mLosers.assign(aTop.begin(), aTop.end());
+        ++mLosersCount;
+    }
+
+    std::vector<TQuote> mGainers;
+    std::vector<TQuote> mLosers;
+    size_t mGainersCount = 0;
+    size_t mLosersCount = 0;
+};
+
+void ShouldFanOutTopsToSubscribers()
+{
+    using namespace std::chrono_literals;
+
+    ManualClock clock;
+    BasicTopSubscriptions<5> subscriptions(clock);
+    BasicTopStocks<5> topStocks(subscriptions, QuoteStore::DefaultDenseLimit, clock);
+    topStocks.EnableTieNotifications(true);
+
+    LastTopSubscriber full, brief, throttled;
+    subscriptions.Subscribe(full, 5);
+    subscriptions.Subscribe(brief, 2);
+    subscriptions.Subscribe(throttled, 3, 10ms);
+
+    for (int i = 1; i <= 10; ++i)
+    {
+        topStocks.OnQuote(i, 100);
+    }
+    assert(full.mGainers == std::vector<TQuote>({{10, 0}, {9, 0}, {8, 0}, {7, 0}, {6, 0}}));
+    assert(brief.mGainers == std::vector<TQuote>({{10, 0}, {9, 0}}));
+    // The first top is notified at once, then the interval holds the next ones back.
+    assert(throttled.mGainers == std::vector<TQuote>({{1, 0}, {0, 0}, {0, 0}}) && throttled.mGainersCount == 1);
+
+    // A change below the shorter top is not notified to it.
+    auto briefCount = brief.mGainersCount;
+    topStocks.OnQuote(6, 90);
+    assert(full.mGainers == std::vector<TQuote>({{10, 0}, {9, 0}, {8, 0}, {7, 0}, {5, 0}}));
+    assert(brief.mGainersCount == briefCount);
+
+    topStocks.OnQuote(5, 110);
+    assert(full.mGainers[0] == TQuote(5, 10));
+    assert(brief.mGainers == std::vector<TQuote>({{5, 10}, {10, 0}}) && brief.mGainersCount == briefCount + 1);
+
+    // The throttled subscriber gets the latest top once its interval has elapsed.
+    subscriptions.Poll();
+    assert(throttled.mGainersCount == 1);
+    clock.Advance(10ms);
+    subscriptions.Poll();
+    assert(throttled.mGainers == std::vector<TQuote>({{5, 10}, {10, 0}, {9, 0}}) && throttled.mGainersCount == 2);
+
+    topStocks.OnQuote(4, 120);
+    assert(throttled.mGainersCount == 2);
+    subscriptions.Flush();
+    assert(throttled.mGainers == std::vector<TQuote>({{4, 20}, {5, 10}, {10, 0}}) && throttled.mGainersCount == 3);
+    subscriptions.Flush();
+    assert(throttled.mGainersCount == 3);
+}
+
+struct LastGroupTopHandler : IGroupTopStocksHandler
+{
+    void ProcessGroupTopGainersChanged(TGroupId aGroupId, const TTopList& aTop) override
+    {
+        mGainers[aGroupId] = aTop;
+    }
+
+    void ProcessGroupTopLosersChanged(TGroupId aGroupId, const TTopList& aTop) override
+    {
+        mLosers[aGroupId] = aTop;
+    }
+
+    std::map<TGroupId, TTopList> mGainers;
+    std::map<TGroupId, TTopList> mLosers;
+};
+
+void ShouldRankGroups()
+{
+    LastGroupTopHandler handler;
+    GroupedTopStocks topStocks(handler);
+
+    // Odd stocks, stocks up to 15 and a small group of three.
+    std::map<TGroupId, std::vector<TId>> groups;
+    for (TId id = 1; id <= 40; ++id)
+    {
+        if (id % 2)
+        {
+            topStocks.AddToGroup(id, 1);
+            groups[1].push_back(id);
+        }
+        if (id <= 15)
+        {
+            topStocks.AddToGroup(id, 2);
+            groups[2].push_back(id);
+        }
+    }
+
+    std::map<TId, std::pair<double, double>> prices;
+    auto expect = [&]()
+    {
+        for (const auto& group : groups)
+        {
+            std::vector<TQuote> changes;
+            for (auto id : group.second)
+            {
+                auto price = prices.find(id);
+                if (price != prices.end())
+                {
+                    changes.emplace_back(id, (price->second.second - price->second.first) / price->second.first * 100);
+                }
+            }
+
+            assert(handler.mGainers[group.first] == MakeTop(changes, std::greater<>()));
+            assert(handler.mLosers[group.first] == MakeTop(changes, std::less<>()));
+        }
+    };
+
+    auto quotes = MakeRandomQuotes(5000, 40, 5);
+    for (size_t i = 0; i < quotes.size(); ++i)
+    {
+        if (i == 1000)
+        {
+            // Joining after being quoted.
+            for (TId id : {2, 4, 40})
+            {
+                topStocks.AddToGroup(id, 3);
+                groups[3].push_back(id);
+            }
+        }
+
+        const auto& quote = quotes[i];
+        auto price = prices.emplace(quote.StockId, std::make_pair(quote.Price, quote.Price)).first;
+        price->second.second = quote.Price;
+        topStocks.OnQuote(quote.StockId, quote.Price);
+
+        expect();
+    }
+    assert(topStocks.GroupsCount() == 3);
+}
+
+void ShouldRankGroupsInBasisPoints()
+{
+    LastTopHandler expected;
+    BasicTopStocks<TopSize, TopMaxCapacity, BasisPointChange<>> topStocks(expected);
+    topStocks.EnableTieNotifications(true);
+
+    LastGroupTopHandler handler;
+    BasicGroupedTopStocks<TopSize, TopMaxCapacity, BasisPointChange<>> groupedTopStocks(handler);
+    for (TId id = 1; id <= 40; ++id)
+    {
+        groupedTopStocks.AddToGroup(id, 1);
+    }
+
+    for (const auto& quote : MakeRandomQuotes(3000, 40, 13))
+    {
+        topStocks.OnQuote(quote.StockId, quote.Price);
+        groupedTopStocks.OnQuote(quote.StockId, quote.Price);
+
+        assert(handler.mGainers[1] == expected.mGainers);
+        assert(handler.mLosers[1] == expected.mLosers);
+    }
+}
+
+void ShouldQueryRanks()
+{
+    LastTopHandler handler;
+    TopStocks topStocks(handler);
+
+    topStocks.OnQuote(1, 100);
+    assert(!topStocks.RankOf(1) && topStocks.Top(5).empty());
+
+    topStocks.EnableOrderIndex(true);
+
+    std::map<TId, std::pair<double, double>> prices;
+    auto quotes = MakeRandomQuotes(3000, 200, 9);
+    quotes.insert(quotes.begin(), {1, 100});
+    for (size_t i = 0; i < quotes.size(); ++i)
+    {
+        const auto& quote = quotes[i];
+        auto price = prices.emplace(quote.StockId, std::make_pair(quote.Price, quote.Price)).first;
+        price->second.second = quote.Price;
+        topStocks.OnQuote(quote.StockId, quote.Price);
+
+        if (i % 100)
+        {
+            continue;
+        }
+
+        std::vector<TQuote> gainers;
+        for (const auto& p : prices)
+        {
+            gainers.emplace_back(p.first, (p.second.second - p.second.first) / p.second.first * 100);
+        }
+        std::sort(gainers.begin(), gainers.end(),
+            [](const auto& l, const auto& r) { return std::make_pair(l.second, l.first) > std::make_pair(r.second, r.first); });
+        std::vector<TQuote> losers(gainers.rbegin(), gainers.rend());
+
+        for (size_t position = 0; position < gainers.size(); ++position)
+        {
+            assert(topStocks.RankOf(gainers[position].first) == position + 1);
+        }
+
+        auto count = std::min<size_t>(50, gainers.size());
+        assert(topStocks.Top(50) == std::vector<TQuote>(gainers.begin(), gainers.begin() + count));
+        assert(topStocks.Bottom(50) == std::vector<TQuote>(losers.begin(), losers.begin() + count));
+        if (gainers.size() > 30)
+        {
+            assert(topStocks.Range(11, 30) == std::vector<TQuote>(gainers.begin() + 10, gainers.begin() + 30));
+        }
+        assert(topStocks.Range(gainers.size(), gainers.size() + 5) == std::vector<TQuote>({gainers.back()}));
+    }
+
+    assert(!topStocks.RankOf(1000) && topStocks.Range(0, 5).empty() && topStocks.Range(5, 4).empty());
+}
+
+void ShouldSelectExtremesWithAnyKernel()
+{
+    using TKernel = ExtremesKernel<TopSelector<TopMaxCapacity>::TGainers, TopSelector<TopMaxCapacity>::TLosers>;
+
+    std::vector<TId> ids;
+    std::vector<TChange> changes;
+    unsigned seed = 5;
+    for (int i = 0; i < 1001; ++i)
+    {
+        seed = seed * 1103515245 + 12345;
+        ids.push_back(static_cast<TId>(seed >> 8) % 100000 + 1);
+        seed = seed * 1103515245 + 12345;
+        changes.push_back(static_cast<TChange>((seed >> 8) % 41) - 20);
+    }
+
+    std::vector<std::pair<TChange, TId>> sorted;
+    for (size_t i = 0; i < ids.size(); ++i)
+    {
+        sorted.emplace_back(changes[i], ids[i]);
+    }
+    std::sort(sorted.begin(), sorted.end());
+
+    TopSelector<TopMaxCapacity>::TGainers expectedGainers;
+    TopSelector<TopMaxCapacity>::TLosers expectedLosers;
+    for (size_t i = 0; i < TopMaxCapacity; ++i)
+    {
+        expectedGainers.Insert(sorted[sorted.size() - i - 1].first, sorted[sorted.size() - i - 1].second);
+        expectedLosers.Insert(sorted[i].first, sorted[i].second);
+    }
+
+    std::vector<TKernel::TFunction> kernels {&TKernel::Scalar};
+    if (TKernel::IsSse2Supported())
+    {
+        kernels.push_back(&TKernel::Sse2);
+    }
+    if (TKernel::IsAvx2Supported())
+    {
+        kernels.push_back(&TKernel::Avx2);
+    }
+
+    for (auto kernel : kernels)
+    {
+        TopSelector<TopMaxCapacity>::TGainers gainers;
+        TopSelector<TopMaxCapacity>::TLosers losers;
+        kernel(changes.data(), ids.data(), ids.size(), gainers, losers);
+
+        assert(AreEqual(expectedGainers, gainers));
+        assert(AreEqual(expectedLosers, losers));
+    }
+}
+
+void ShouldHostSeveralTopSizes()
+{
+    BasicLastTopHandler<3> top3;
+    BasicTopStocks<3> topStocks3(top3);
+
+    BasicLastTopHandler<25> top25;
+    BasicTopStocks<25, 32> topStocks25(top25);
+
+    std::vector<TQuote> changes;
+    for (int i = 1; i <= 40; ++i)
+    {
+        topStocks3.OnQuote(i, 100);
+        topStocks25.OnQuote(i, 100);
+        changes.emplace_back(i, 0);
+    }
+
+    for (int i = 1; i <= 40; ++i)
+    {
+        topStocks3.OnQuote(i, 100 + i);
+        topStocks25.OnQuote(i, 100 + i);
+        changes[i - 1].second = (100. + i - 100) / 100 * 100;
+
+        assert(top3.mGainers == MakeTop<3>(changes, std::greater<>()));
+        assert(top25.mGainers == MakeTop<25>(changes, std::greater<>()));
+    }
+
+    for (int i = 40; i >= 1; i -= 3)
+    {
+        topStocks3.OnQuote(i, 100 - i);
+        topStocks25.OnQuote(i, 100 - i);
+        changes[i - 1].second = (100. - i - 100) / 100 * 100;
+
+        assert(top3.mLosers == MakeTop<3>(changes, std::less<>()));
+        assert(top25.mLosers == MakeTop<25>(changes, std::less<>()));
+    }
+
+    assert(top3.mGainers == MakeTop<3>(changes, std::greater<>()));
+    assert(top25.mGainers == MakeTop<25>(changes, std::greater<>()));
+}
+
+void ShouldNotifyStockEnteringAtLastPosition()
+{
+    auto quotes = MakeRandomQuotes(20000, 300, 21);
+
+    BasicLastTopHandler<3> top3;
+    BasicTopStocks<3> topStocks3(top3);
+
+    BasicLastTopHandler<25> top25;
+    BasicTopStocks<25, 32> topStocks25(top25);
+
+    std::vector<double> bases(301);
+    std::vector<TQuote> changes;
+    for (const auto& quote : quotes)
+    {
+        topStocks3.OnQuote(quote.StockId, quote.Price);
+        topStocks25.OnQuote(quote.StockId, quote.Price);
+
+        auto& base = bases[quote.StockId];
+        if (!base)
+        {
+            base = quote.Price;
+            changes.emplace_back(quote.StockId, 0);
+        }
+        else
+        {
+            auto change = std::find_if(changes.begin(), changes.end(),
+                [&quote](const auto& e) { return e.first == quote.StockId; });
+            change->second = (quote.Price - base) / base * 100;
+        }
+    }
+
+    assert(top3.mGainers == MakeTop<3>(changes, std::greater<>()));
+    assert(top3.mLosers == MakeTop<3>(changes, std::less<>()));
+    assert(top25.mGainers == MakeTop<25>(changes, std::greater<>()));
+    assert(top25.mLosers == MakeTop<25>(changes, std::less<>()));
+}
+
+void ShouldKeepSlackForSmallTops()
+{
+    static_assert(DefaultTopCapacity<1> == 7 && DefaultTopCapacity<3> == 9, "");
+    static_assert(DefaultTopCapacity<TopSize> == TopMaxCapacity && DefaultTopCapacity<20> == 32, "");
+
+    auto quotes = MakeRandomQuotes(20000, 300, 17);
+
+    BasicLastTopHandler<1> top1;
+    BasicTopStocks<1> topStocks1(top1);
+    topStocks1.EnableTieNotifications(true);
+    assert(topStocks1.GainersStats().Capacity == DefaultTopCapacity<1>);
+
+    BasicLastTopHandler<TopSize> expected;
+    TopStocks topStocks(expected);
+    topStocks.EnableTieNotifications(true);
+    for (const auto& quote : quotes)
+    {
+        topStocks1.OnQuote(quote.StockId, quote.Price);
+        topStocks.OnQuote(quote.StockId, quote.Price);
+
+        assert(top1.mGainers[0] == expected.mGainers[0]);
+        assert(top1.mLosers[0] == expected.mLosers[0]);
+    }
+}
+
 void Add20Stocks(TopStocksHandlerMock& aMock, TopStocks& aTopStocks)
 {
     aMock.ExpectGainers({{{1, 0}}});
@@ -586,6 +2184,39 @@ int main(int argc, char *argv[])
     ShouldRemoveOldPercents();
     ShouldReturnTopTen();
     ShouldOperateMoreThan20();
+    ShouldTrackSparseIds();
+    ShouldSuppressUnchangedTop();
+    ShouldNotifyTiedEntries();
+    ShouldNotifyOncePerBatch();
+    ShouldNotifyFinalTopOfBatch();
+    ShouldConflateNotifications();
+    ShouldMergeShardTops();
+    ShouldDropOldestQuotes();
+    ShouldConflateQueuedQuotes();
+    ShouldProcessQueuedQuotes();
+    ShouldRestoreFromOrderIndex();
+    ShouldAdaptCandidateCapacity();
+    ShouldReportMetrics();
+    ShouldRecordTickJournal();
+    ShouldRejectInvalidJournal();
+    ShouldCompareTopListLogs();
+    ShouldWarmRestartFromSnapshot();
+    ShouldRejectCorruptSnapshot();
+    ShouldNotifyDeltas();
+    ShouldHandOffLatestTop();
+    ShouldRenderRows();
+    ShouldRankRollingWindows();
+    ShouldComputeBasisPointChanges();
+    ShouldDispatchStatically();
+    ShouldFanOutTopsToSubscribers();
+    ShouldRankGroups();
+    ShouldRankGroupsInBasisPoints();
+    ShouldQueryRanks();
+    ShouldKeepCandidatesOrderedWithTies();
+    ShouldSelectExtremesWithAnyKernel();
+    ShouldHostSeveralTopSizes();
+    ShouldNotifyStockEnteringAtLastPosition();
+    ShouldKeepSlackForSmallTops();
 
     std::cout << "All tests passed." << std::endl;
     return 0;
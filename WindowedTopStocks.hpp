@@ -0,0 +1,232 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "Clock.hpp"
+#include "TopStocks.hpp"
+
+namespace top_stocks
+{
+
+// A rolling window and the handler of its tops.
+template <size_t K>
+struct BasicRollingWindow
+{
+    TDuration Length;
+    IBasicTopStocksHandler<K>& Handler;
+};
+
+using RollingWindow = BasicRollingWindow<TopSize>;
+
+// Ranks the stocks by their change over several rolling windows, e.g. the last 1, 5 and 15 minutes, every
+// window notifying its own gainers and losers. Time is divided into buckets and the base of a stock in a window
+// is its last price as of the bucket which has just left the window, or its first price if it is younger.
+// Every stock keeps the closing prices of the buckets in a fixed ring spanning the longest window. A timer wheel
+// lists the stocks which ticked in every bucket, so only those are rebased when the bucket leaves a window.
+// A quote costs O(windows) plus O(windows) rebases once its bucket ages, whatever the history.
+template <size_t K = TopSize, size_t Capacity = DefaultTopCapacity<K>, typename TChangeModel = PercentChange>
+struct BasicWindowedTopStocks : ITopStocks
+{
+    using TWindow = BasicRollingWindow<K>;
+    using TWindowTopStocks = BasicTopStocks<K, Capacity, TChangeModel>;
+
+    // Window lengths should be multiples of the bucket length.
+    BasicWindowedTopStocks(const std::vector<TWindow>& aWindows, TDuration aBucketLength,
+        TId aDenseIdLimit = QuoteStore::DefaultDenseLimit, const IClock& aClock = SteadyClock::Instance())
+        : mBucketLength(aBucketLength)
+        , mClock(aClock)
+        , mStocks(aDenseIdLimit)
+    {
+        assert(aBucketLength.count() > 0);
+
+        std::int64_t longest = 0;
+        for (const auto& window : aWindows)
+        {
+            assert(window.Length.count() > 0 && window.Length % aBucketLength == TDuration::zero());
+
+            auto buckets = static_cast<std::int64_t>(window.Length / aBucketLength);
+            longest = std::max(longest, buckets);
+            mWindows.push_back({buckets,
+                std::make_unique<TWindowTopStocks>(window.Handler, aDenseIdLimit, aClock)});
+            // A window ties the stocks at 0% whenever they are rebased to their last prices.
+            mWindows.back().TopStocks->EnableTieNotifications(true);
+        }
+
+        mRingSize = static_cast<size_t>(longest) + 1;
+        mWheel.resize(mRingSize);
+        mBucket = Bucket();
+    }
+
+    // The engine of a window, e.g. to set its conflation or to read its metrics. Quotes should not be
+    // passed to it directly.
+    TWindowTopStocks& Window(size_t aIndex)
+    {
+        return *mWindows[aIndex].TopStocks;
+    }
+
+    // Ages the windows up to now and notifies the conflated tops whose interval has elapsed. Should be called
+    // periodically, otherwise the windows age only when quotes arrive.
+    void Poll()
+    {
+        Advance();
+        for (auto& window : mWindows)
+        {
+            window.TopStocks->Poll();
+        }
+    }
+
+    // Quotes with non-positive ids or prices are ignored.
+    void OnQuote(int aStockId, double aPrice) override
+    {
+        Advance();
+        Apply(aStockId, aPrice);
+    }
+
+    void OnQuotes(Span<const Quote> aQuotes) override
+    {
+        Advance();
+
+        for (auto& window : mWindows)
+        {
+            window.TopStocks->BeginBatch();
+        }
+
+        for (const auto& quote : aQuotes)
+        {
+            Apply(quote.StockId, quote.Price);
+        }
+
+        for (auto& window : mWindows)
+        {
+            window.TopStocks->EndBatch();
+        }
+    }
+
+private:
+
+    struct WindowState
+    {
+        std::int64_t Buckets;
+        std::unique_ptr<TWindowTopStocks> TopStocks;
+    };
+
+    // The stocks which ticked within a bucket.
+    struct WheelSlot
+    {
+        std::int64_t Bucket = -1;
+        std::vector<QuoteStore::TSlot> Stocks;
+    };
+
+    std::int64_t Bucket() const
+    {
+        return static_cast<std::int64_t>(mClock.Now().time_since_epoch() / mBucketLength);
+    }
+
+    size_t RingIndex(std::int64_t aBucket) const
+    {
+        return static_cast<size_t>(aBucket) % mRingSize;
+    }
+
+    void Apply(TId aStockId, double aPrice)
+    {
+        if (aStockId <= 0 || aPrice <= 0)
+        {
+            return;
+        }
+
+        auto slot = mStocks.Find(aStockId);
+        if (slot == QuoteStore::NoSlot)
+        {
+            slot = mStocks.Insert(aStockId, aPrice, 0.);
+            mLastBuckets.push_back(-1);
+            mCloses.resize(mCloses.size() + mRingSize);
+        }
+        else
+        {
+            mStocks.Base(slot) = aPrice;
+        }
+
+        if (mLastBuckets[slot] != mBucket)
+        {
+            mLastBuckets[slot] = mBucket;
+
+            auto& wheelSlot = mWheel[RingIndex(mBucket)];
+            if (wheelSlot.Bucket != mBucket)
+            {
+                wheelSlot.Bucket = mBucket;
+                wheelSlot.Stocks.clear();
+            }
+            wheelSlot.Stocks.push_back(slot);
+        }
+        mCloses[slot * mRingSize + RingIndex(mBucket)] = aPrice;
+
+        for (auto& window : mWindows)
+        {
+            window.TopStocks->OnQuote(aStockId, aPrice);
+        }
+    }
+
+    // Rebases the stocks of the buckets which have left every window since the previous call, one batch
+    // per window. Buckets older than a window are never revisited, so a long pause costs O(ring) at most.
+    void Advance()
+    {
+        auto now = Bucket();
+        if (now <= mBucket)
+        {
+            return;
+        }
+
+        for (auto& window : mWindows)
+        {
+            // The buckets leaving the window, only those up to the previous one may have ticks.
+            auto first = mBucket - window.Buckets + 1;
+            auto last = std::min(now - window.Buckets, mBucket);
+            if (first > last)
+            {
+                continue;
+            }
+
+            window.TopStocks->BeginBatch();
+            for (auto bucket = std::max<std::int64_t>(first, 0); bucket <= last; ++bucket)
+            {
+                const auto& wheelSlot = mWheel[RingIndex(bucket)];
+                if (wheelSlot.Bucket != bucket)
+                {
+                    continue;
+                }
+
+                for (auto slot : wheelSlot.Stocks)
+                {
+                    window.TopStocks->Rebase(mStocks.Id(slot), mCloses[slot * mRingSize + RingIndex(bucket)],
+                        mStocks.Base(slot));
+                }
+            }
+            window.TopStocks->EndBatch();
+        }
+
+        mBucket = now;
+    }
+
+    const TDuration mBucketLength;
+    const IClock& mClock;
+
+    std::vector<WindowState> mWindows;
+
+    // Resolves the ids to slots and holds the last prices as the bases.
+    QuoteStore mStocks;
+    std::vector<std::int64_t> mLastBuckets;
+    // The closing prices of the last buckets, a ring per stock.
+    std::vector<double> mCloses;
+    size_t mRingSize = 0;
+
+    std::vector<WheelSlot> mWheel;
+    std::int64_t mBucket = 0;
+};
+
+using WindowedTopStocks = BasicWindowedTopStocks<TopSize, TopMaxCapacity>;
+
+}